@@ -0,0 +1,373 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__ALLOCATION_PROFILER_HPP_
+#define DEMO_NODES_CPP__ALLOCATION_PROFILER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define DEMO_NODES_CPP__ALLOCATION_PROFILER_BACKTRACE 1
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DEMO_NODES_CPP__ALLOCATION_PROFILER_NOINLINE __attribute__((noinline))
+#else
+#define DEMO_NODES_CPP__ALLOCATION_PROFILER_NOINLINE
+#endif
+
+namespace demo_nodes_cpp
+{
+
+/// Counts the allocations a program makes while it runs, broken down by phase, size class and
+/// call site, so the code paths which still allocate per message can be found.
+/// Recording only touches preallocated atomic counters, so it is thread-safe and may be called
+/// from operator new and from custom allocators. Building the report allocates, so print it
+/// after stop().
+class AllocationProfiler final
+{
+public:
+  /// What the allocating thread was doing, as declared with a Scope.
+  enum class Phase : size_t
+  {
+    /// Outside of any scope, e.g. the application creating its messages.
+    Other = 0,
+    /// Inside Publisher::publish().
+    Publish = 1,
+    /// Inside the executor but outside of user callbacks: waiting, taking and dispatching.
+    Take = 2,
+    /// Inside a user callback.
+    Execute = 3,
+  };
+  static constexpr size_t num_phases = 4;
+
+  /// What served the allocation.
+  enum class Source : size_t
+  {
+    /// The global operator new.
+    GlobalNew = 0,
+    /// The custom allocator or memory resource handed to rclcpp.
+    Allocator = 1,
+  };
+  static constexpr size_t num_sources = 2;
+
+  /// Sizes are binned by the next power of two; the last class collects everything larger.
+  static constexpr size_t num_size_classes = 24;
+  static constexpr size_t max_call_sites = 512;
+  static constexpr size_t max_frames = 8;
+
+  /// Set the phase of the calling thread for the lifetime of the scope; scopes nest.
+  class Scope final
+  {
+public:
+    explicit Scope(Phase phase)
+    : previous_(current_phase())
+    {
+      current_phase() = phase;
+    }
+
+    ~Scope()
+    {
+      current_phase() = previous_;
+    }
+
+    Scope(const Scope &) = delete;
+    Scope & operator=(const Scope &) = delete;
+
+private:
+    Phase previous_;
+  };
+
+  /// \brief The profiler of the process
+  static AllocationProfiler & instance()
+  {
+    static AllocationProfiler profiler;
+    return profiler;
+  }
+
+  /// \brief Start counting
+  /// \param frames How many frames of each call site to keep, 0 to not collect call sites
+  void start(size_t frames = 4)
+  {
+    frames_ = std::min(frames, max_frames);
+#ifdef DEMO_NODES_CPP__ALLOCATION_PROFILER_BACKTRACE
+    if (frames_ > 0) {
+      // The first backtrace loads the unwinder, which allocates; get that out of the way.
+      void * warm_up[1];
+      backtrace(warm_up, 1);
+    }
+#endif
+    running_.store(true, std::memory_order_release);
+  }
+
+  /// \brief Stop counting; the counters are kept for the report
+  void stop()
+  {
+    running_.store(false, std::memory_order_release);
+  }
+
+  bool running() const
+  {
+    return running_.load(std::memory_order_relaxed);
+  }
+
+  /// \brief Record an allocation of the calling thread
+  DEMO_NODES_CPP__ALLOCATION_PROFILER_NOINLINE
+  void allocated(Source source, size_t bytes)
+  {
+    if (!running() || in_profiler()) {
+      return;
+    }
+    in_profiler() = true;
+    Phase phase = current_phase();
+    Counters & counters = counters_[static_cast<size_t>(phase)][static_cast<size_t>(source)];
+    counters.allocs.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters.sizes[size_class(bytes)].fetch_add(1, std::memory_order_relaxed);
+#ifdef DEMO_NODES_CPP__ALLOCATION_PROFILER_BACKTRACE
+    if (frames_ > 0) {
+      // Skip this function and the allocation function which called it.
+      void * frames[max_frames + 2];
+      int depth = backtrace(frames, static_cast<int>(frames_ + 2));
+      if (depth > 2) {
+        record_call_site(phase, source, bytes, frames + 2, static_cast<size_t>(depth - 2));
+      }
+    }
+#endif
+    in_profiler() = false;
+  }
+
+  /// \brief Record a deallocation of the calling thread
+  void deallocated(Source source)
+  {
+    if (!running() || in_profiler()) {
+      return;
+    }
+    counters_[static_cast<size_t>(current_phase())][static_cast<size_t>(source)].deallocs.fetch_add(
+      1, std::memory_order_relaxed);
+  }
+
+  /// \brief How many allocations were recorded from the given source, across all phases
+  uint64_t allocations(Source source) const
+  {
+    uint64_t total = 0;
+    for (const auto & phase : counters_) {
+      total += phase[static_cast<size_t>(source)].allocs.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /// \brief How many deallocations were recorded from the given source, across all phases
+  uint64_t deallocations(Source source) const
+  {
+    uint64_t total = 0;
+    for (const auto & phase : counters_) {
+      total += phase[static_cast<size_t>(source)].deallocs.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /// \brief Print the counters and size classes per phase, then the busiest call sites
+  /// \param top How many call sites to print
+  void print_report(size_t top = 10) const
+  {
+    printf("\nAllocations by phase:\n");
+    printf("%-8s %-10s %12s %12s %14s\n", "phase", "source", "allocs", "deallocs", "bytes");
+    for (size_t phase = 0; phase < num_phases; ++phase) {
+      for (size_t source = 0; source < num_sources; ++source) {
+        const Counters & counters = counters_[phase][source];
+        printf(
+          "%-8s %-10s %12" PRIu64 " %12" PRIu64 " %14" PRIu64 "\n",
+          phase_name(static_cast<Phase>(phase)), source_name(static_cast<Source>(source)),
+          counters.allocs.load(), counters.deallocs.load(), counters.bytes.load());
+      }
+    }
+
+    printf("\nAllocations by size:\n");
+    printf("%-10s", "size <=");
+    for (size_t phase = 0; phase < num_phases; ++phase) {
+      printf(" %10s", phase_name(static_cast<Phase>(phase)));
+    }
+    printf("\n");
+    for (size_t size = 0; size < num_size_classes; ++size) {
+      std::array<uint64_t, num_phases> row{};
+      uint64_t total = 0;
+      for (size_t phase = 0; phase < num_phases; ++phase) {
+        for (size_t source = 0; source < num_sources; ++source) {
+          row[phase] += counters_[phase][source].sizes[size].load();
+        }
+        total += row[phase];
+      }
+      if (total == 0) {
+        continue;
+      }
+      if (size + 1 == num_size_classes) {
+        printf("%-10s", "larger");
+      } else {
+        printf("%-10zu", size_t{1} << size);
+      }
+      for (uint64_t count : row) {
+        printf(" %10" PRIu64, count);
+      }
+      printf("\n");
+    }
+
+    std::vector<const CallSite *> sites;
+    for (const CallSite & site : call_sites_) {
+      if (site.ready.load(std::memory_order_acquire)) {
+        sites.push_back(&site);
+      }
+    }
+    if (sites.empty()) {
+      return;
+    }
+    std::sort(
+      sites.begin(), sites.end(), [](const CallSite * a, const CallSite * b) {
+        return a->count.load() > b->count.load();
+      });
+    sites.resize(std::min(sites.size(), top));
+    printf("\nCall sites which allocated most often:\n");
+    for (size_t i = 0; i < sites.size(); ++i) {
+      const CallSite & site = *sites[i];
+      printf(
+        "#%zu: %" PRIu64 " allocs, %" PRIu64 " bytes, phase %s, %s\n", i + 1, site.count.load(),
+        site.bytes.load(), phase_name(site.phase), source_name(site.source));
+#ifdef DEMO_NODES_CPP__ALLOCATION_PROFILER_BACKTRACE
+      char ** symbols = backtrace_symbols(site.frames.data(), static_cast<int>(site.depth));
+      for (size_t frame = 0; frame < site.depth; ++frame) {
+        printf("    %s\n", symbols ? symbols[frame] : "?");
+      }
+      std::free(symbols);
+#endif
+    }
+    uint64_t unrecorded = unrecorded_.load();
+    if (unrecorded > 0) {
+      printf("%" PRIu64 " allocations did not fit into the call site table\n", unrecorded);
+    }
+  }
+
+  static const char * phase_name(Phase phase)
+  {
+    static const char * names[num_phases] = {"other", "publish", "take", "execute"};
+    return names[static_cast<size_t>(phase)];
+  }
+
+  static const char * source_name(Source source)
+  {
+    static const char * names[num_sources] = {"global new", "allocator"};
+    return names[static_cast<size_t>(source)];
+  }
+
+private:
+  struct Counters
+  {
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> deallocs{0};
+    std::atomic<uint64_t> bytes{0};
+    std::array<std::atomic<uint64_t>, num_size_classes> sizes{};
+  };
+
+  struct CallSite
+  {
+    /// Hash of the frames, phase and source; 0 while the slot is free.
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> bytes{0};
+    /// Set once the thread which claimed the slot filled in the fields below.
+    std::atomic<bool> ready{false};
+    std::array<void *, max_frames> frames{};
+    size_t depth = 0;
+    Phase phase = Phase::Other;
+    Source source = Source::GlobalNew;
+  };
+
+  AllocationProfiler() = default;
+
+  static Phase & current_phase()
+  {
+    thread_local Phase phase = Phase::Other;
+    return phase;
+  }
+
+  /// Set while the calling thread records, so allocations made by the profiler are not counted.
+  static bool & in_profiler()
+  {
+    thread_local bool busy = false;
+    return busy;
+  }
+
+  static size_t size_class(size_t bytes)
+  {
+    size_t size = 0;
+    while (size + 1 < num_size_classes && (size_t{1} << size) < bytes) {
+      ++size;
+    }
+    return size;
+  }
+
+  void record_call_site(
+    Phase phase, Source source, size_t bytes, void * const * frames, size_t depth)
+  {
+    // FNV-1a over the return addresses, then mixed with the phase and source.
+    uint64_t key = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < depth; ++i) {
+      key = (key ^ reinterpret_cast<uintptr_t>(frames[i])) * 0x100000001b3ull;
+    }
+    key = (key ^ (static_cast<uint64_t>(phase) << 8 | static_cast<uint64_t>(source))) *
+      0x100000001b3ull;
+    key |= 1;  // Keep 0 for free slots.
+    // Linear probing over a bounded window, so a full table costs a few lookups at most.
+    for (size_t probe = 0; probe < 16; ++probe) {
+      CallSite & site = call_sites_[(key + probe) % max_call_sites];
+      uint64_t expected = site.key.load(std::memory_order_acquire);
+      if (expected == 0 &&
+        site.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+      {
+        std::copy(frames, frames + depth, site.frames.begin());
+        site.depth = depth;
+        site.phase = phase;
+        site.source = source;
+        site.ready.store(true, std::memory_order_release);
+        expected = key;
+      }
+      if (expected == key) {
+        site.count.fetch_add(1, std::memory_order_relaxed);
+        site.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        return;
+      }
+    }
+    unrecorded_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<bool> running_{false};
+  size_t frames_ = 0;
+  std::array<std::array<Counters, num_sources>, num_phases> counters_{};
+  std::array<CallSite, max_call_sites> call_sites_{};
+  std::atomic<uint64_t> unrecorded_{0};
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__ALLOCATION_PROFILER_HPP_
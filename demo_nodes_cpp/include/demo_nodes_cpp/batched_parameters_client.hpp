@@ -0,0 +1,244 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__BATCHED_PARAMETERS_CLIENT_HPP_
+#define DEMO_NODES_CPP__BATCHED_PARAMETERS_CLIENT_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter_descriptor.hpp"
+#include "rcl_interfaces/msg/set_parameters_result.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Gets, sets and describes many parameters of a remote node at once.
+/// A call is split into requests of at most batch_size parameters each, of which at most
+/// max_in_flight are outstanding at a time, the next one being sent as soon as one is answered.
+/// That way a call for thousands of parameters costs a few round trips, without one huge
+/// request holding up the remote node's executor, or the middleware, for long.
+/// The returned future is ready once every request was answered, with the results in the order
+/// of the parameters of the call. It holds an exception if any of the requests failed.
+/// A node which doesn't allow undeclared parameters answers a get or describe request naming one
+/// of them with no results at all. Such a request is split in halves and sent again, until the
+/// undeclared parameters are found, so each of them costs a few more round trips.
+/// Like AsyncParametersClient, it needs the node to be spun for the responses to arrive.
+class BatchedParametersClient final
+{
+public:
+  /// \brief Create the client
+  /// \param node The node to create the service clients of
+  /// \param remote_node_name The node whose parameters to access, this node if empty
+  /// \param batch_size Parameters per request
+  /// \param max_in_flight Requests outstanding at a time
+  /// \throws std::invalid_argument if batch_size or max_in_flight is 0
+  BatchedParametersClient(
+    rclcpp::Node::SharedPtr node, const std::string & remote_node_name = "",
+    size_t batch_size = 100, size_t max_in_flight = 4)
+  : client_(std::make_shared<rclcpp::AsyncParametersClient>(node, remote_node_name)),
+    batch_size_(batch_size), max_in_flight_(max_in_flight)
+  {
+    if (batch_size_ == 0 || max_in_flight_ == 0) {
+      throw std::invalid_argument("batch_size and max_in_flight must be at least 1");
+    }
+  }
+
+  /// \brief Wait for the remote node's parameter services
+  template<typename RepT, typename RatioT>
+  bool wait_for_service(std::chrono::duration<RepT, RatioT> timeout)
+  {
+    return client_->wait_for_service(timeout);
+  }
+
+  /// \brief Get the values of parameters, unset for those which aren't declared
+  std::shared_future<std::vector<rclcpp::Parameter>>
+  get_parameters(std::vector<std::string> names)
+  {
+    auto client = client_;
+    return Batch<std::string, rclcpp::Parameter>::start(
+      std::move(names), batch_size_, max_in_flight_,
+      [client](std::vector<std::string> chunk, auto callback) {
+        client->get_parameters(chunk, callback);
+      },
+      [](const std::string & name) {return rclcpp::Parameter(name);});
+  }
+
+  /// \brief Set parameters, each on its own, so some may fail while others succeed
+  std::shared_future<std::vector<rcl_interfaces::msg::SetParametersResult>>
+  set_parameters(std::vector<rclcpp::Parameter> parameters)
+  {
+    auto client = client_;
+    return Batch<rclcpp::Parameter, rcl_interfaces::msg::SetParametersResult>::start(
+      std::move(parameters), batch_size_, max_in_flight_,
+      [client](std::vector<rclcpp::Parameter> chunk, auto callback) {
+        client->set_parameters(chunk, callback);
+      });
+  }
+
+  /// \brief Describe parameters, of type PARAMETER_NOT_SET for those which aren't declared
+  std::shared_future<std::vector<rcl_interfaces::msg::ParameterDescriptor>>
+  describe_parameters(std::vector<std::string> names)
+  {
+    auto client = client_;
+    return Batch<std::string, rcl_interfaces::msg::ParameterDescriptor>::start(
+      std::move(names), batch_size_, max_in_flight_,
+      [client](std::vector<std::string> chunk, auto callback) {
+        client->describe_parameters(chunk, callback);
+      },
+      [](const std::string & name) {
+        rcl_interfaces::msg::ParameterDescriptor descriptor;
+        descriptor.name = name;
+        return descriptor;
+      });
+  }
+
+private:
+  // One call: the items still to send, and the results of the requests answered so far.
+  // Each request's callback holds on to it until the last one completes the promise.
+  template<typename ItemT, typename ResultT>
+  class Batch : public std::enable_shared_from_this<Batch<ItemT, ResultT>>
+  {
+public:
+    using Results = std::vector<ResultT>;
+    using Callback = std::function<void (std::shared_future<Results>)>;
+    using Send = std::function<void (std::vector<ItemT>, Callback)>;
+    /// The result for an item which isn't declared, if a request may be answered with nothing.
+    using Unset = std::function<ResultT(const ItemT &)>;
+
+    static std::shared_future<Results> start(
+      std::vector<ItemT> items, size_t batch_size, size_t max_in_flight, Send send,
+      Unset unset = nullptr)
+    {
+      auto batch = std::make_shared<Batch>(
+        std::move(items), batch_size, max_in_flight, std::move(send), std::move(unset));
+      std::shared_future<Results> future = batch->promise_.get_future().share();
+      if (batch->items_.empty()) {
+        batch->promise_.set_value({});
+        return future;
+      }
+      std::lock_guard<std::mutex> lock(batch->mutex_);
+      batch->send_more();
+      return future;
+    }
+
+    Batch(
+      std::vector<ItemT> items, size_t batch_size, size_t max_in_flight, Send send, Unset unset)
+    : items_(std::move(items)), results_(items_.size()), batch_size_(batch_size),
+      max_in_flight_(max_in_flight), send_(std::move(send)), unset_(std::move(unset))
+    {
+    }
+
+private:
+    // The helpers below are called with mutex_ held.
+    bool has_work() const
+    {
+      return !retries_.empty() || next_ < items_.size();
+    }
+
+    void send_more()
+    {
+      while (in_flight_ < max_in_flight_ && has_work()) {
+        send_next();
+      }
+    }
+
+    void send_next()
+    {
+      size_t begin = next_;
+      size_t end = std::min(items_.size(), begin + batch_size_);
+      if (!retries_.empty()) {
+        begin = retries_.back().first;
+        end = retries_.back().second;
+        retries_.pop_back();
+      } else {
+        next_ = end;
+      }
+      ++in_flight_;
+      std::vector<ItemT> chunk(items_.begin() + begin, items_.begin() + end);
+      auto self = this->shared_from_this();
+      send_(
+        std::move(chunk), [self, begin, end](std::shared_future<Results> future) {
+          self->on_response(begin, end, future);
+        });
+    }
+
+    void on_response(size_t begin, size_t end, std::shared_future<Results> future)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --in_flight_;
+      if (failed_) {
+        return;
+      }
+      try {
+        const Results & chunk = future.get();
+        if (chunk.empty() && unset_) {
+          // Some item of the request isn't declared; narrow it down.
+          if (end - begin == 1) {
+            results_[begin] = unset_(items_[begin]);
+          } else {
+            size_t middle = begin + (end - begin) / 2;
+            retries_.emplace_back(middle, end);
+            retries_.emplace_back(begin, middle);
+          }
+        } else if (chunk.size() != end - begin) {
+          throw std::runtime_error("parameter service answered for the wrong number");
+        } else {
+          std::copy(chunk.begin(), chunk.end(), results_.begin() + begin);
+        }
+      } catch (...) {
+        failed_ = true;
+        promise_.set_exception(std::current_exception());
+        return;
+      }
+      send_more();
+      if (!has_work() && in_flight_ == 0) {
+        promise_.set_value(std::move(results_));
+      }
+    }
+
+    std::mutex mutex_;
+    std::vector<ItemT> items_;
+    Results results_;
+    size_t batch_size_;
+    size_t max_in_flight_;
+    Send send_;
+    Unset unset_;
+    size_t next_ = 0;
+    // Ranges of items to send again, the next one last.
+    std::vector<std::pair<size_t, size_t>> retries_;
+    size_t in_flight_ = 0;
+    bool failed_ = false;
+    std::promise<Results> promise_;
+  };
+
+  rclcpp::AsyncParametersClient::SharedPtr client_;
+  size_t batch_size_;
+  size_t max_in_flight_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__BATCHED_PARAMETERS_CLIENT_HPP_
@@ -0,0 +1,151 @@
+// Copyright 2019 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__BOUNDED_MESSAGE_HPP_
+#define DEMO_NODES_CPP__BOUNDED_MESSAGE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bounded_msgs/msg/bounded_string.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// \brief Copy text into a bounded string, truncating it to the capacity of the message
+/// \return Whether all of the text fit
+inline bool assign(bounded_msgs::msg::BoundedString & msg, const char * text, size_t length)
+{
+  size_t size = std::min(length, msg.data.size());
+  std::memcpy(msg.data.data(), text, size);
+  msg.size = static_cast<uint32_t>(size);
+  return size == length;
+}
+
+inline bool assign(bounded_msgs::msg::BoundedString & msg, const std::string & text)
+{
+  return assign(msg, text.data(), text.size());
+}
+
+/// \brief The text held by a bounded string
+inline std::string to_string(const bounded_msgs::msg::BoundedString & msg)
+{
+  size_t size = std::min<size_t>(msg.size, msg.data.size());
+  return std::string(reinterpret_cast<const char *>(msg.data.data()), size);
+}
+
+/// Publishes into messages loaned from the middleware if it can loan them, and otherwise into
+/// messages from a pool allocated up front, so no message is allocated per publish either way.
+/// Without loans, publish() serializes or copies the message before it returns, so a message
+/// only stays out of the pool while it is being filled and published.
+template<typename MessageT>
+class LoanOrPoolPublisher final
+{
+public:
+  /// \brief Wrap a publisher
+  /// \param publisher The publisher to publish with
+  /// \param pool_size How many messages to preallocate for threads publishing at the same time
+  explicit LoanOrPoolPublisher(
+    typename rclcpp::Publisher<MessageT>::SharedPtr publisher, size_t pool_size = 1)
+  : publisher_(std::move(publisher))
+  {
+    free_.reserve(pool_size);
+    for (size_t i = 0; i < pool_size; ++i) {
+      free_.push_back(std::make_unique<MessageT>());
+    }
+  }
+
+  /// \brief Fill a message and publish it
+  /// \param fill Called with the message to fill, which may hold the contents of an earlier one
+  template<typename FillT>
+  void publish(FillT && fill)
+  {
+    if (publisher_->can_loan_messages()) {
+      auto loaned_msg = publisher_->borrow_loaned_message();
+      fill(loaned_msg.get());
+      publisher_->publish(std::move(loaned_msg));
+      ++loaned_;
+      return;
+    }
+    std::unique_ptr<MessageT> msg = acquire();
+    fill(*msg);
+    publisher_->publish(*msg);
+    release(std::move(msg));
+  }
+
+  /// \brief Whether the middleware loans messages of this type
+  bool loaning() const
+  {
+    return publisher_->can_loan_messages();
+  }
+
+  /// \brief How many messages were published into loans
+  size_t loaned() const
+  {
+    return loaned_;
+  }
+
+  /// \brief How many messages were published from the pool
+  size_t pooled() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pooled_;
+  }
+
+  /// \brief How many messages had to be allocated because the pool was empty
+  size_t overflows() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overflows_;
+  }
+
+private:
+  std::unique_ptr<MessageT> acquire()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pooled_;
+    if (free_.empty()) {
+      ++overflows_;
+      return std::make_unique<MessageT>();
+    }
+    std::unique_ptr<MessageT> msg = std::move(free_.back());
+    free_.pop_back();
+    return msg;
+  }
+
+  void release(std::unique_ptr<MessageT> msg)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(std::move(msg));
+  }
+
+  typename rclcpp::Publisher<MessageT>::SharedPtr publisher_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<MessageT>> free_;
+  std::atomic<size_t> loaned_{0};
+  size_t pooled_ = 0;
+  size_t overflows_ = 0;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__BOUNDED_MESSAGE_HPP_
@@ -0,0 +1,850 @@
+// Copyright 2022 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__CONTENT_FILTER_HPP_
+#define DEMO_NODES_CPP__CONTENT_FILTER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "rcl/types.h"
+#include "rclcpp/serialized_message.hpp"
+#include "rosidl_runtime_c/message_type_support_struct.h"
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+#include "rosidl_typesupport_introspection_cpp/field_types.hpp"
+#include "rosidl_typesupport_introspection_cpp/identifier.hpp"
+#include "rosidl_typesupport_introspection_cpp/message_introspection.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Evaluates a content filter expression on serialized messages, for middlewares which can't
+/// filter topics themselves.
+/// The expression uses the same SQL-like syntax as
+/// rclcpp::SubscriptionOptions::content_filter_options: comparisons (=, <>, !=, <, <=, >, >=,
+/// LIKE and BETWEEN) of fields, literals and %n parameters, combined with AND, OR, NOT and
+/// parentheses, e.g. "data < %0 OR data > %1" or "header.frame_id LIKE 'base%'".
+/// The expression is compiled once, against the introspection type support of the message, into
+/// a plan of which CDR fields to read and a small bytecode program. matches() then reads just
+/// those fields out of the CDR buffer and runs the program, so samples which are rejected are
+/// never deserialized.
+/// Fields can be primitives or strings, also inside nested messages, but not array elements.
+/// Integers are compared as doubles, so 64-bit values beyond 2^53 lose precision.
+class ContentFilter final
+{
+public:
+  /// \brief Compile a filter for the type of message MessageT
+  template<typename MessageT>
+  static ContentFilter create(
+    const std::string & expression, const std::vector<std::string> & parameters)
+  {
+    return ContentFilter(
+      rosidl_typesupport_cpp::get_message_type_support_handle<MessageT>(),
+      expression, parameters);
+  }
+
+  /// \brief Compile a filter
+  /// \param type_support The type support of the message, from any type support library which
+  ///   can hand out its introspection type support
+  /// \param expression The filter expression
+  /// \param parameters The values of the %0, %1, ... parameters in the expression. Strings are
+  ///   quoted, as in "'text'".
+  /// \throws std::invalid_argument If the expression doesn't parse or doesn't fit the message
+  ContentFilter(
+    const rosidl_message_type_support_t * type_support, const std::string & expression,
+    const std::vector<std::string> & parameters)
+  : parameters_(parameters)
+  {
+    const rosidl_message_type_support_t * introspection = type_support->func(
+      type_support, rosidl_typesupport_introspection_cpp::typesupport_identifier);
+    if (introspection == nullptr) {
+      throw std::invalid_argument("the message has no introspection type support");
+    }
+    plans_.push_back(Plan(static_cast<const Members *>(introspection->data)));
+    Parser parser(*this, expression);
+    parser.parse();
+    for (const Plan & plan : plans_) {
+      for (size_t i = 0; i < plan.end; ++i) {
+        if (plan.child[i] < 0 && plan.slot[i] < 0) {
+          check_skippable(plan.members->members_[i]);
+        }
+      }
+    }
+  }
+
+  /// \brief Whether a serialized message passes the filter
+  /// Messages which aren't little or big endian plain CDR, or which end early, pass, so that
+  /// deserializing them reports what is wrong with them.
+  bool matches(const rcl_serialized_message_t & msg) const
+  {
+    if (msg.buffer_length < 4 || msg.buffer[0] != 0 || msg.buffer[1] > 1) {
+      return true;
+    }
+    Cdr cdr{msg.buffer + 4, msg.buffer + 4, msg.buffer + msg.buffer_length, false};
+    const bool little_endian = msg.buffer[1] == 1;
+    const uint16_t probe = 1;
+    cdr.swap = little_endian != (*reinterpret_cast<const uint8_t *>(&probe) == 1);
+
+    std::array<Value, kMaxFields> fields;
+    if (!read_message(cdr, 0, fields)) {
+      return true;
+    }
+    uint64_t stack = 0;
+    for (const Instruction & instruction : program_) {
+      switch (instruction.op) {
+        case Op::Compare:
+          stack = (stack << 1) | compare(
+            instruction.cmp, value(instruction.lhs, fields), value(instruction.rhs, fields));
+          break;
+        case Op::Like:
+          stack = (stack << 1) |
+            like(value(instruction.lhs, fields).text, value(instruction.rhs, fields).text);
+          break;
+        case Op::Not:
+          stack ^= 1;
+          break;
+        case Op::And:
+          stack = (stack >> 2) << 1 | ((stack & (stack >> 1)) & 1);
+          break;
+        case Op::Or:
+          stack = (stack >> 2) << 1 | ((stack | (stack >> 1)) & 1);
+          break;
+      }
+    }
+    return stack & 1;
+  }
+
+  bool matches(const rclcpp::SerializedMessage & msg) const
+  {
+    return matches(msg.get_rcl_serialized_message());
+  }
+
+private:
+  using Member = rosidl_typesupport_introspection_cpp::MessageMember;
+  using Members = rosidl_typesupport_introspection_cpp::MessageMembers;
+
+  // The depth of the boolean stack is bounded by its bits.
+  static constexpr size_t kMaxDepth = 64;
+  static constexpr size_t kMaxFields = 32;
+
+  enum class Op : uint8_t {Compare, Like, Not, And, Or};
+  enum class Cmp : uint8_t {Eq, Ne, Lt, Le, Gt, Ge};
+  enum class Kind : uint8_t {Number, String};
+
+  struct Value
+  {
+    Kind kind = Kind::Number;
+    double number = 0.0;
+    std::string_view text;
+  };
+
+  struct Constant
+  {
+    Kind kind;
+    double number;
+    std::string text;
+  };
+
+  // A field read from the message or a constant.
+  struct Operand
+  {
+    bool field;
+    uint16_t index;
+  };
+
+  struct Instruction
+  {
+    Op op;
+    Cmp cmp;
+    Operand lhs;
+    Operand rhs;
+  };
+
+  // What to do with each member of a message up to the last one the filter reads: read it into
+  // a slot, descend into it, or skip over it.
+  struct Plan
+  {
+    explicit Plan(const Members * message)
+    : members(message), slot(message->member_count_, -1), child(message->member_count_, -1)
+    {
+    }
+
+    const Members * members;
+    std::vector<int> slot;
+    std::vector<int> child;
+    size_t end = 0;
+  };
+
+  struct Cdr
+  {
+    const uint8_t * origin;
+    const uint8_t * pos;
+    const uint8_t * end;
+    bool swap;
+
+    bool align(size_t alignment)
+    {
+      size_t misalignment = static_cast<size_t>(pos - origin) % alignment;
+      return misalignment == 0 || skip(alignment - misalignment);
+    }
+
+    bool skip(size_t bytes)
+    {
+      if (static_cast<size_t>(end - pos) < bytes) {
+        return false;
+      }
+      pos += bytes;
+      return true;
+    }
+
+    template<typename T>
+    bool read(T & value)
+    {
+      if (!align(sizeof(T)) || static_cast<size_t>(end - pos) < sizeof(T)) {
+        return false;
+      }
+      uint8_t bytes[sizeof(T)];
+      std::memcpy(bytes, pos, sizeof(T));
+      if (swap) {
+        for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+          std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+        }
+      }
+      std::memcpy(&value, bytes, sizeof(T));
+      pos += sizeof(T);
+      return true;
+    }
+
+    bool read(std::string_view & text)
+    {
+      uint32_t length;
+      if (!read(length) || static_cast<size_t>(end - pos) < length) {
+        return false;
+      }
+      // The length counts the terminating null character.
+      text = std::string_view(reinterpret_cast<const char *>(pos), length > 0 ? length - 1 : 0);
+      pos += length;
+      return true;
+    }
+  };
+
+  // A token of the expression.
+  struct Token
+  {
+    enum Type {End, Name, Number, String, Parameter, Symbol} type;
+    std::string text;
+    size_t position;
+  };
+
+  class Parser
+  {
+public:
+    Parser(ContentFilter & filter, const std::string & expression)
+    : filter_(filter), expression_(expression)
+    {
+      next();
+    }
+
+    void parse()
+    {
+      parse_or();
+      if (token_.type != Token::End) {
+        fail("unexpected '" + token_.text + "'");
+      }
+      if (filter_.program_.empty()) {
+        fail("empty expression");
+      }
+    }
+
+private:
+    // A parsed operand, whose type may only be known once the other side of a comparison is.
+    struct Term
+    {
+      bool field = false;
+      uint16_t slot = 0;
+      Kind kind = Kind::Number;
+      // The text of a literal or parameter, and whether it was a quoted string.
+      std::string text;
+      bool quoted = false;
+    };
+
+    void parse_or()
+    {
+      parse_and();
+      while (keyword("OR")) {
+        next();
+        parse_and();
+        emit(Op::Or, -1);
+      }
+    }
+
+    void parse_and()
+    {
+      parse_not();
+      while (keyword("AND")) {
+        next();
+        parse_not();
+        emit(Op::And, -1);
+      }
+    }
+
+    void parse_not()
+    {
+      if (keyword("NOT")) {
+        next();
+        parse_not();
+        emit(Op::Not, 0);
+        return;
+      }
+      if (symbol("(")) {
+        next();
+        parse_or();
+        expect(")");
+        return;
+      }
+      parse_comparison();
+    }
+
+    void parse_comparison()
+    {
+      Term lhs = parse_term();
+      bool negate = false;
+      if (keyword("NOT")) {
+        negate = true;
+        next();
+        if (!keyword("BETWEEN") && !keyword("LIKE")) {
+          fail("expected BETWEEN or LIKE after NOT");
+        }
+      }
+      if (keyword("BETWEEN")) {
+        next();
+        Term low = parse_term();
+        if (!keyword("AND")) {
+          fail("expected AND in BETWEEN");
+        }
+        next();
+        Term high = parse_term();
+        emit_compare(Cmp::Ge, lhs, low);
+        emit_compare(Cmp::Le, lhs, high);
+        emit(Op::And, -1);
+      } else if (keyword("LIKE")) {
+        next();
+        Term pattern = parse_term();
+        lhs.kind = resolve(lhs, Kind::String);
+        pattern.kind = resolve(pattern, Kind::String);
+        emit(Op::Like, 1, Cmp::Eq, operand(lhs), operand(pattern));
+      } else {
+        static const std::pair<const char *, Cmp> operators[] = {
+          {"=", Cmp::Eq}, {"<>", Cmp::Ne}, {"!=", Cmp::Ne}, {"<=", Cmp::Le}, {">=", Cmp::Ge},
+          {"<", Cmp::Lt}, {">", Cmp::Gt}};
+        for (const auto & op : operators) {
+          if (symbol(op.first)) {
+            next();
+            emit_compare(op.second, lhs, parse_term());
+            return;
+          }
+        }
+        fail("expected a comparison");
+      }
+      if (negate) {
+        emit(Op::Not, 0);
+      }
+    }
+
+    Term parse_term()
+    {
+      Term term;
+      switch (token_.type) {
+        case Token::Name:
+          if (upper(token_.text) == "TRUE" || upper(token_.text) == "FALSE") {
+            term.text = upper(token_.text) == "TRUE" ? "1" : "0";
+          } else {
+            term.field = true;
+            filter_.add_field(token_.text, term.slot, term.kind);
+          }
+          break;
+        case Token::Number:
+          term.text = token_.text;
+          break;
+        case Token::String:
+          term.text = token_.text;
+          term.quoted = true;
+          break;
+        case Token::Parameter: {
+            size_t index = std::stoul(token_.text);
+            if (index >= filter_.parameters_.size()) {
+              fail("there is no parameter %" + token_.text);
+            }
+            term.text = filter_.parameters_[index];
+            if (term.text.size() >= 2 && term.text.front() == '\'' && term.text.back() == '\'') {
+              term.text = term.text.substr(1, term.text.size() - 2);
+              term.quoted = true;
+            }
+            break;
+          }
+        default:
+          fail("expected a field, a literal or a parameter");
+      }
+      next();
+      return term;
+    }
+
+    void emit_compare(Cmp cmp, Term lhs, Term rhs)
+    {
+      // A literal takes the type of the field it is compared with.
+      Kind kind = lhs.field ? lhs.kind : rhs.field ? rhs.kind :
+        (number(lhs) && number(rhs)) ? Kind::Number : Kind::String;
+      lhs.kind = resolve(lhs, kind);
+      rhs.kind = resolve(rhs, kind);
+      emit(Op::Compare, 1, cmp, operand(lhs), operand(rhs));
+    }
+
+    Kind resolve(const Term & term, Kind kind)
+    {
+      if (term.field) {
+        if (term.kind != kind) {
+          fail("a string field can't be compared with a number");
+        }
+        return kind;
+      }
+      if (kind == Kind::Number && (term.quoted || !number(term))) {
+        fail("'" + term.text + "' is not a number");
+      }
+      if (kind == Kind::String && !term.quoted) {
+        fail(term.text + " is not a quoted string");
+      }
+      return kind;
+    }
+
+    static bool number(const Term & term)
+    {
+      if (term.field || term.quoted || term.text.empty()) {
+        return term.field && term.kind == Kind::Number;
+      }
+      char * end = nullptr;
+      std::strtod(term.text.c_str(), &end);
+      return *end == '\0';
+    }
+
+    Operand operand(const Term & term)
+    {
+      if (term.field) {
+        return Operand{true, term.slot};
+      }
+      Constant constant{term.kind, 0.0, term.text};
+      if (term.kind == Kind::Number) {
+        constant.number = std::strtod(term.text.c_str(), nullptr);
+      }
+      filter_.constants_.push_back(std::move(constant));
+      return Operand{false, static_cast<uint16_t>(filter_.constants_.size() - 1)};
+    }
+
+    // Append an instruction which changes the depth of the boolean stack by delta.
+    void emit(Op op, int delta, Cmp cmp = Cmp::Eq, Operand lhs = {}, Operand rhs = {})
+    {
+      depth_ += delta;
+      if (depth_ > static_cast<int>(kMaxDepth)) {
+        fail("the expression is nested too deeply");
+      }
+      filter_.program_.push_back(Instruction{op, cmp, lhs, rhs});
+    }
+
+    bool keyword(const char * word) const
+    {
+      return token_.type == Token::Name && upper(token_.text) == word;
+    }
+
+    bool symbol(const char * text) const
+    {
+      return token_.type == Token::Symbol && token_.text == text;
+    }
+
+    void expect(const char * text)
+    {
+      if (!symbol(text)) {
+        fail(std::string("expected '") + text + "'");
+      }
+      next();
+    }
+
+    void next()
+    {
+      while (pos_ < expression_.size() && std::isspace(static_cast<unsigned char>(current()))) {
+        ++pos_;
+      }
+      token_ = Token{Token::End, "", pos_};
+      if (pos_ >= expression_.size()) {
+        return;
+      }
+      char c = current();
+      if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+        token_.type = Token::Name;
+        while (pos_ < expression_.size() &&
+          (std::isalnum(static_cast<unsigned char>(current())) || current() == '_' ||
+          current() == '.'))
+        {
+          token_.text += expression_[pos_++];
+        }
+      } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+        ((c == '-' || c == '+' || c == '.') && pos_ + 1 < expression_.size() &&
+        (std::isdigit(static_cast<unsigned char>(expression_[pos_ + 1])) ||
+        expression_[pos_ + 1] == '.')))
+      {
+        token_.type = Token::Number;
+        const char * begin = expression_.c_str() + pos_;
+        char * end = nullptr;
+        std::strtod(begin, &end);
+        token_.text.assign(begin, static_cast<size_t>(end - begin));
+        pos_ += token_.text.size();
+      } else if (c == '\'') {
+        token_.type = Token::String;
+        size_t close = expression_.find('\'', pos_ + 1);
+        if (close == std::string::npos) {
+          fail("unterminated string");
+        }
+        token_.text = expression_.substr(pos_ + 1, close - pos_ - 1);
+        pos_ = close + 1;
+      } else if (c == '%') {
+        token_.type = Token::Parameter;
+        ++pos_;
+        while (pos_ < expression_.size() && std::isdigit(static_cast<unsigned char>(current()))) {
+          token_.text += expression_[pos_++];
+        }
+        if (token_.text.empty() || token_.text.size() > 2) {
+          fail("expected a parameter number after %");
+        }
+      } else {
+        token_.type = Token::Symbol;
+        static const char * symbols[] = {"<>", "!=", "<=", ">=", "=", "<", ">", "(", ")"};
+        for (const char * symbol : symbols) {
+          if (expression_.compare(pos_, std::strlen(symbol), symbol) == 0) {
+            token_.text = symbol;
+            pos_ += token_.text.size();
+            return;
+          }
+        }
+        fail(std::string("unexpected '") + c + "'");
+      }
+    }
+
+    char current() const
+    {
+      return expression_[pos_];
+    }
+
+    static std::string upper(std::string text)
+    {
+      for (char & c : text) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      }
+      return text;
+    }
+
+    [[noreturn]] void fail(const std::string & reason) const
+    {
+      throw std::invalid_argument(
+        "invalid filter expression \"" + expression_ + "\" at " +
+        std::to_string(token_.position) + ": " + reason);
+    }
+
+    ContentFilter & filter_;
+    const std::string & expression_;
+    size_t pos_ = 0;
+    Token token_;
+    int depth_ = 0;
+  };
+
+  /// Find the member a dotted path names, and plan to read it into a slot.
+  void add_field(const std::string & path, uint16_t & slot, Kind & kind)
+  {
+    auto known = field_slots_.find(path);
+    if (known != field_slots_.end()) {
+      slot = known->second.first;
+      kind = known->second.second;
+      return;
+    }
+    size_t plan = 0;
+    size_t begin = 0;
+    while (true) {
+      size_t dot = path.find('.', begin);
+      std::string name = path.substr(begin, dot == std::string::npos ? dot : dot - begin);
+      const Members * members = plans_[plan].members;
+      size_t index = 0;
+      while (index < members->member_count_ && name != members->members_[index].name_) {
+        ++index;
+      }
+      if (index == members->member_count_) {
+        throw std::invalid_argument(
+          "no field '" + name + "' in " + members->message_namespace_ + "::" +
+          members->message_name_);
+      }
+      const Member & member = members->members_[index];
+      if (member.is_array_) {
+        throw std::invalid_argument("can't filter on the array '" + path + "'");
+      }
+      plans_[plan].end = std::max(plans_[plan].end, index + 1);
+      if (dot == std::string::npos) {
+        if (!readable(member.type_id_)) {
+          throw std::invalid_argument("can't filter on the type of '" + path + "'");
+        }
+        if (field_count_ == kMaxFields) {
+          throw std::invalid_argument("the expression reads too many fields");
+        }
+        slot = static_cast<uint16_t>(field_count_++);
+        kind = member.type_id_ == rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING ?
+          Kind::String : Kind::Number;
+        plans_[plan].slot[index] = slot;
+        field_slots_[path] = {slot, kind};
+        return;
+      }
+      if (member.type_id_ != rosidl_typesupport_introspection_cpp::ROS_TYPE_MESSAGE) {
+        throw std::invalid_argument("'" + name + "' in '" + path + "' is not a message");
+      }
+      if (plans_[plan].child[index] < 0) {
+        plans_[plan].child[index] = static_cast<int>(plans_.size());
+        plans_.push_back(Plan(static_cast<const Members *>(member.members_->data)));
+      }
+      plan = static_cast<size_t>(plans_[plan].child[index]);
+      begin = dot + 1;
+    }
+  }
+
+  static bool readable(uint8_t type_id)
+  {
+    return primitive_size(type_id) > 0 ||
+           type_id == rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING;
+  }
+
+  /// The CDR size of a primitive, or 0 if the type isn't one.
+  static size_t primitive_size(uint8_t type_id)
+  {
+    namespace types = rosidl_typesupport_introspection_cpp;
+    switch (type_id) {
+      case types::ROS_TYPE_BOOLEAN:
+      case types::ROS_TYPE_OCTET:
+      case types::ROS_TYPE_CHAR:
+      case types::ROS_TYPE_UINT8:
+      case types::ROS_TYPE_INT8:
+        return 1;
+      case types::ROS_TYPE_UINT16:
+      case types::ROS_TYPE_INT16:
+        return 2;
+      case types::ROS_TYPE_FLOAT:
+      case types::ROS_TYPE_UINT32:
+      case types::ROS_TYPE_INT32:
+        return 4;
+      case types::ROS_TYPE_DOUBLE:
+      case types::ROS_TYPE_UINT64:
+      case types::ROS_TYPE_INT64:
+        return 8;
+      default:
+        return 0;
+    }
+  }
+
+  /// Make sure the filter knows how to step over a member it doesn't read.
+  static void check_skippable(const Member & member)
+  {
+    namespace types = rosidl_typesupport_introspection_cpp;
+    if (member.type_id_ == types::ROS_TYPE_MESSAGE) {
+      const auto * members = static_cast<const Members *>(member.members_->data);
+      for (uint32_t i = 0; i < members->member_count_; ++i) {
+        check_skippable(members->members_[i]);
+      }
+    } else if (primitive_size(member.type_id_) == 0 &&
+      member.type_id_ != types::ROS_TYPE_STRING)
+    {
+      throw std::invalid_argument(
+        std::string("can't read past the field '") + member.name_ + "' to the filtered ones");
+    }
+  }
+
+  bool read_message(Cdr & cdr, size_t plan_index, std::array<Value, kMaxFields> & fields) const
+  {
+    const Plan & plan = plans_[plan_index];
+    for (size_t i = 0; i < plan.end; ++i) {
+      const Member & member = plan.members->members_[i];
+      bool ok = plan.child[i] >= 0 ? read_message(cdr, static_cast<size_t>(plan.child[i]), fields) :
+        plan.slot[i] >= 0 ? read_value(cdr, member.type_id_, fields[plan.slot[i]]) :
+        skip_member(cdr, member);
+      if (!ok) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool read_value(Cdr & cdr, uint8_t type_id, Value & value)
+  {
+    namespace types = rosidl_typesupport_introspection_cpp;
+    switch (type_id) {
+      case types::ROS_TYPE_STRING:
+        value.kind = Kind::String;
+        return cdr.read(value.text);
+      case types::ROS_TYPE_BOOLEAN:
+      case types::ROS_TYPE_OCTET:
+      case types::ROS_TYPE_CHAR:
+      case types::ROS_TYPE_UINT8:
+        return read_number<uint8_t>(cdr, value);
+      case types::ROS_TYPE_INT8:
+        return read_number<int8_t>(cdr, value);
+      case types::ROS_TYPE_UINT16:
+        return read_number<uint16_t>(cdr, value);
+      case types::ROS_TYPE_INT16:
+        return read_number<int16_t>(cdr, value);
+      case types::ROS_TYPE_UINT32:
+        return read_number<uint32_t>(cdr, value);
+      case types::ROS_TYPE_INT32:
+        return read_number<int32_t>(cdr, value);
+      case types::ROS_TYPE_UINT64:
+        return read_number<uint64_t>(cdr, value);
+      case types::ROS_TYPE_INT64:
+        return read_number<int64_t>(cdr, value);
+      case types::ROS_TYPE_FLOAT:
+        return read_number<float>(cdr, value);
+      case types::ROS_TYPE_DOUBLE:
+        return read_number<double>(cdr, value);
+      default:
+        return false;
+    }
+  }
+
+  template<typename T>
+  static bool read_number(Cdr & cdr, Value & value)
+  {
+    T number;
+    if (!cdr.read(number)) {
+      return false;
+    }
+    value.kind = Kind::Number;
+    value.number = static_cast<double>(number);
+    return true;
+  }
+
+  static bool skip_member(Cdr & cdr, const Member & member)
+  {
+    size_t count = 1;
+    if (member.is_array_) {
+      if (member.is_upper_bound_ || member.array_size_ == 0) {
+        uint32_t length;
+        if (!cdr.read(length)) {
+          return false;
+        }
+        count = length;
+      } else {
+        count = member.array_size_;
+      }
+    }
+    size_t size = primitive_size(member.type_id_);
+    if (size > 0) {
+      return count == 0 || (cdr.align(size) && count <= SIZE_MAX / size && cdr.skip(count * size));
+    }
+    for (size_t i = 0; i < count; ++i) {
+      bool ok;
+      if (member.type_id_ == rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING) {
+        std::string_view text;
+        ok = cdr.read(text);
+      } else {
+        ok = skip_message(cdr, *static_cast<const Members *>(member.members_->data));
+      }
+      if (!ok) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool skip_message(Cdr & cdr, const Members & members)
+  {
+    for (uint32_t i = 0; i < members.member_count_; ++i) {
+      if (!skip_member(cdr, members.members_[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Value value(Operand operand, const std::array<Value, kMaxFields> & fields) const
+  {
+    if (operand.field) {
+      return fields[operand.index];
+    }
+    const Constant & constant = constants_[operand.index];
+    return Value{constant.kind, constant.number, constant.text};
+  }
+
+  static bool compare(Cmp cmp, const Value & lhs, const Value & rhs)
+  {
+    int order = lhs.kind == Kind::String ? lhs.text.compare(rhs.text) :
+      (lhs.number < rhs.number ? -1 : lhs.number > rhs.number ? 1 : 0);
+    switch (cmp) {
+      case Cmp::Eq: return order == 0;
+      case Cmp::Ne: return order != 0;
+      case Cmp::Lt: return order < 0;
+      case Cmp::Le: return order <= 0;
+      case Cmp::Gt: return order > 0;
+      case Cmp::Ge: return order >= 0;
+    }
+    return false;
+  }
+
+  /// SQL LIKE: % matches any run of characters and _ any single one.
+  static bool like(std::string_view text, std::string_view pattern)
+  {
+    size_t t = 0;
+    size_t p = 0;
+    size_t star = std::string_view::npos;
+    size_t resume = 0;
+    while (t < text.size()) {
+      if (p < pattern.size() && (pattern[p] == '_' || pattern[p] == text[t])) {
+        ++t;
+        ++p;
+      } else if (p < pattern.size() && pattern[p] == '%') {
+        star = p++;
+        resume = t;
+      } else if (star != std::string_view::npos) {
+        p = star + 1;
+        t = ++resume;
+      } else {
+        return false;
+      }
+    }
+    while (p < pattern.size() && pattern[p] == '%') {
+      ++p;
+    }
+    return p == pattern.size();
+  }
+
+  std::vector<std::string> parameters_;
+  std::vector<Plan> plans_;
+  std::map<std::string, std::pair<uint16_t, Kind>> field_slots_;
+  size_t field_count_ = 0;
+  std::vector<Constant> constants_;
+  std::vector<Instruction> program_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__CONTENT_FILTER_HPP_
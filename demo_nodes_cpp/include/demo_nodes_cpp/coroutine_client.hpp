@@ -0,0 +1,163 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__COROUTINE_CLIENT_HPP_
+#define DEMO_NODES_CPP__COROUTINE_CLIENT_HPP_
+
+#if !defined(__cpp_impl_coroutine)
+#error "coroutine_client.hpp needs C++20 coroutines"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// A coroutine which nothing waits for: it starts running when it is called, and frees itself
+/// when it returns. After a co_await, it goes on on the executor thread which resumed it.
+/// An exception escaping it terminates the process.
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void() noexcept
+    {
+    }
+
+    void unhandled_exception() noexcept
+    {
+      std::terminate();
+    }
+  };
+};
+
+/// Awaits the response to a service request. The coroutine is suspended while the request is
+/// out, and resumed from the client's response callback, so no thread waits for the response.
+/// If the client goes away before the response arrives, the coroutine is never resumed.
+template<typename ServiceT>
+class ResponseAwaiter final
+{
+public:
+  using Client = rclcpp::Client<ServiceT>;
+
+  ResponseAwaiter(typename Client::SharedPtr client, typename Client::SharedRequest request)
+  : client_(std::move(client)), request_(std::move(request))
+  {
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    // With a multi-threaded executor the coroutine may be resumed, and this awaiter destroyed,
+    // before async_send_request() returns, so nothing may be touched after it.
+    client_->async_send_request(
+      request_, [this, handle](typename Client::SharedFuture future) {
+        response_ = future.get();
+        handle.resume();
+      });
+  }
+
+  typename Client::SharedResponse await_resume()
+  {
+    return std::move(response_);
+  }
+
+private:
+  typename Client::SharedPtr client_;
+  typename Client::SharedRequest request_;
+  typename Client::SharedResponse response_;
+};
+
+/// \brief Send a request, for a coroutine to co_await the response
+/// \return An awaitable whose result is the response
+template<typename ServiceT>
+ResponseAwaiter<ServiceT> async_call(
+  std::shared_ptr<rclcpp::Client<ServiceT>> client,
+  typename rclcpp::Client<ServiceT>::SharedRequest request)
+{
+  return ResponseAwaiter<ServiceT>(std::move(client), std::move(request));
+}
+
+/// Awaits a one-off timer of a node, so a coroutine can wait without holding up a thread.
+class SleepAwaiter final
+{
+public:
+  SleepAwaiter(rclcpp::Node & node, std::chrono::nanoseconds duration)
+  : node_(node), duration_(duration)
+  {
+  }
+
+  bool await_ready() const noexcept
+  {
+    return duration_.count() <= 0;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    // As for ResponseAwaiter, resuming may destroy this awaiter, so the callback touches none of
+    // its members. The timer only starts once timer_ holds it, and the local copy keeps it alive
+    // for the rest of this call in case it fires on another thread right away.
+    auto timer = node_.create_wall_timer(
+      duration_, [handle](rclcpp::TimerBase & timer) {
+        timer.cancel();
+        handle.resume();
+      }, nullptr, false);
+    timer_ = timer;
+    timer->reset();
+  }
+
+  void await_resume() const noexcept
+  {
+  }
+
+private:
+  rclcpp::Node & node_;
+  std::chrono::nanoseconds duration_;
+  rclcpp::TimerBase::SharedPtr timer_;
+};
+
+/// \brief Wait for a while, for a coroutine to co_await
+inline SleepAwaiter sleep_for(rclcpp::Node & node, std::chrono::nanoseconds duration)
+{
+  return SleepAwaiter(node, duration);
+}
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__COROUTINE_CLIENT_HPP_
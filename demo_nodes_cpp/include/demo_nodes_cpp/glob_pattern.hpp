@@ -0,0 +1,121 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__GLOB_PATTERN_HPP_
+#define DEMO_NODES_CPP__GLOB_PATTERN_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace demo_nodes_cpp
+{
+
+/// A glob pattern for node and parameter names, in which '*' stands for any characters, '/'
+/// and '.' included, and '?' for any one character.
+/// The pattern is split at its '*'s once, when it is created. Matching a name then takes
+/// comparing its start and its end with the first and last piece, and finding the pieces in
+/// between in order, each as early as it occurs, which is linear in the length of the name for
+/// the patterns names are usually matched with. Patterns without '*' are compared whole.
+class GlobPattern final
+{
+public:
+  /// \brief Compile a pattern
+  explicit GlobPattern(const std::string & pattern)
+  : pattern_(pattern), any_character_(pattern.find('?') != std::string::npos)
+  {
+    size_t begin = 0;
+    for (size_t star = pattern.find('*'); star != std::string::npos;
+      star = pattern.find('*', begin))
+    {
+      pieces_.push_back(pattern.substr(begin, star - begin));
+      begin = star + 1;
+    }
+    pieces_.push_back(pattern.substr(begin));
+    for (const auto & piece : pieces_) {
+      min_size_ += piece.size();
+    }
+  }
+
+  /// \brief The pattern as it was given
+  const std::string & pattern() const
+  {
+    return pattern_;
+  }
+
+  /// \brief Whether a name matches the pattern
+  bool match(const std::string & name) const
+  {
+    if (pieces_.size() == 1) {
+      return name.size() == min_size_ && matches_at(name, 0, pieces_.front());
+    }
+    if (name.size() < min_size_) {
+      return false;
+    }
+    const std::string & last = pieces_.back();
+    const size_t end = name.size() - last.size();
+    if (!matches_at(name, 0, pieces_.front()) || !matches_at(name, end, last)) {
+      return false;
+    }
+    size_t position = pieces_.front().size();
+    for (size_t i = 1; i + 1 < pieces_.size(); ++i) {
+      position = find(name, position, end, pieces_[i]);
+      if (position == std::string::npos) {
+        return false;
+      }
+      position += pieces_[i].size();
+    }
+    return true;
+  }
+
+private:
+  bool matches_at(const std::string & name, size_t position, const std::string & piece) const
+  {
+    if (!any_character_) {
+      return name.compare(position, piece.size(), piece) == 0;
+    }
+    for (size_t i = 0; i < piece.size(); ++i) {
+      if (piece[i] != '?' && piece[i] != name[position + i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The first position from which the piece matches and ends by end, npos if there is none.
+  size_t find(const std::string & name, size_t from, size_t end, const std::string & piece) const
+  {
+    if (!any_character_) {
+      size_t position = name.find(piece, from);
+      return position != std::string::npos && position + piece.size() <= end ?
+             position : std::string::npos;
+    }
+    for (size_t position = from; position + piece.size() <= end; ++position) {
+      if (matches_at(name, position, piece)) {
+        return position;
+      }
+    }
+    return std::string::npos;
+  }
+
+  std::string pattern_;
+  bool any_character_;
+  // The pattern split at its '*'s, so there is one piece more than there are '*'s.
+  std::vector<std::string> pieces_;
+  size_t min_size_ = 0;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__GLOB_PATTERN_HPP_
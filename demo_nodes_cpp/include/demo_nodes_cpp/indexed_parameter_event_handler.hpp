@@ -0,0 +1,351 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__INDEXED_PARAMETER_EVENT_HANDLER_HPP_
+#define DEMO_NODES_CPP__INDEXED_PARAMETER_EVENT_HANDLER_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter.hpp"
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include "demo_nodes_cpp/glob_pattern.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Calls back on changes to parameters, like rclcpp::ParameterEventHandler, with the parameter
+/// callbacks indexed by node and parameter name.
+/// rclcpp::ParameterEventHandler checks each of its parameter callbacks against every event, so
+/// an event costs a pass over all of the callbacks, each of them searching the event for its
+/// parameter. Here an event costs one lookup of its node, and one lookup per parameter in it,
+/// however many callbacks there are.
+/// Filtered callbacks watch the parameters matching a glob pattern, of the nodes matching
+/// another. Which of them a node's name matches is worked out at the node's first event, so
+/// an event of a node none of them watch costs one lookup, and only the parameters which match
+/// are converted to rclcpp::Parameter.
+/// As with rclcpp::ParameterEventHandler, callbacks are called from the node's executor, the
+/// newest first, and may add and remove callbacks, and a callback is only called for as long as
+/// its handle is kept.
+class IndexedParameterEventHandler final
+{
+public:
+  using ParameterCallbackType = std::function<void (const rclcpp::Parameter &)>;
+  using ParameterEventCallbackType =
+    std::function<void (const rcl_interfaces::msg::ParameterEvent &)>;
+
+  struct ParameterCallbackHandle
+  {
+    std::string parameter_name;
+    std::string node_name;
+    ParameterCallbackType callback;
+  };
+
+  struct ParameterEventCallbackHandle
+  {
+    ParameterEventCallbackType callback;
+  };
+
+  using FilteredParameterCallbackType =
+    std::function<void (const std::string & node_name, const rclcpp::Parameter &)>;
+
+  struct FilteredParameterCallbackHandle
+  {
+    GlobPattern parameter_pattern;
+    GlobPattern node_pattern;
+    FilteredParameterCallbackType callback;
+  };
+
+  /// \brief Subscribe to /parameter_events with the given node
+  template<typename NodeT>
+  explicit IndexedParameterEventHandler(
+    NodeT node, const rclcpp::QoS & qos = rclcpp::ParameterEventsQoS())
+  : node_base_(rclcpp::node_interfaces::get_node_base_interface(node)),
+    callbacks_(std::make_shared<Callbacks>())
+  {
+    auto callbacks = callbacks_;
+    subscription_ = rclcpp::create_subscription<rcl_interfaces::msg::ParameterEvent>(
+      node, "/parameter_events", qos,
+      [callbacks](std::shared_ptr<rcl_interfaces::msg::ParameterEvent> event) {
+        callbacks->event_callback(*event);
+      });
+  }
+
+  /// \brief Call back on new values of a parameter
+  /// \param parameter_name The parameter
+  /// \param callback Called with the parameter whenever it is declared or changed
+  /// \param node_name The node of the parameter, relative to this node's namespace unless it
+  ///   starts with '/', this node if empty
+  /// \return The handle of the callback, which is dropped along with it
+  std::shared_ptr<ParameterCallbackHandle> add_parameter_callback(
+    const std::string & parameter_name, ParameterCallbackType callback,
+    const std::string & node_name = "")
+  {
+    auto handle = std::make_shared<ParameterCallbackHandle>();
+    handle->parameter_name = parameter_name;
+    handle->node_name = resolve_path(node_name);
+    handle->callback = std::move(callback);
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    callbacks_->parameter_callbacks[handle->node_name][parameter_name].push_front(handle);
+    return handle;
+  }
+
+  /// \brief Stop calling back on a parameter
+  /// \throws std::runtime_error if the callback isn't there
+  void remove_parameter_callback(const std::shared_ptr<ParameterCallbackHandle> & handle)
+  {
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    auto & nodes = callbacks_->parameter_callbacks;
+    auto node = handle ? nodes.find(handle->node_name) : nodes.end();
+    if (node != nodes.end()) {
+      auto parameter = node->second.find(handle->parameter_name);
+      if (parameter != node->second.end()) {
+        auto & handles = parameter->second;
+        auto it = std::find_if(
+          handles.begin(), handles.end(), [&handle](const auto & other) {
+            return other.lock() == handle;
+          });
+        if (it != handles.end()) {
+          handles.erase(it);
+          if (handles.empty()) {
+            node->second.erase(parameter);
+            if (node->second.empty()) {
+              nodes.erase(node);
+            }
+          }
+          return;
+        }
+      }
+    }
+    throw std::runtime_error("Parameter callback doesn't exist");
+  }
+
+  /// \brief Call back on new values of the parameters matching a pattern
+  /// \param parameter_pattern Glob pattern of the parameters' names, see GlobPattern
+  /// \param callback Called with the node's name and the parameter whenever one of the
+  ///   parameters is declared or changed
+  /// \param node_pattern Glob pattern of the nodes' names, relative to this node's namespace
+  ///   unless it starts with '/' or '*', this node if empty
+  /// \return The handle of the callback, which is dropped along with it
+  std::shared_ptr<FilteredParameterCallbackHandle> add_filtered_parameter_callback(
+    const std::string & parameter_pattern, FilteredParameterCallbackType callback,
+    const std::string & node_pattern = "")
+  {
+    auto handle = std::make_shared<FilteredParameterCallbackHandle>(
+      FilteredParameterCallbackHandle{
+        GlobPattern(parameter_pattern),
+        GlobPattern(
+          !node_pattern.empty() && node_pattern.front() == '*' ?
+          node_pattern : resolve_path(node_pattern)),
+        std::move(callback)});
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    callbacks_->filtered_callbacks.push_front(handle);
+    callbacks_->filtered_callbacks_by_node.clear();
+    return handle;
+  }
+
+  /// \brief Stop calling back on the parameters matching a pattern
+  /// \throws std::runtime_error if the callback isn't there
+  void remove_filtered_parameter_callback(
+    const std::shared_ptr<FilteredParameterCallbackHandle> & handle)
+  {
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    auto & handles = callbacks_->filtered_callbacks;
+    auto it = std::find_if(
+      handles.begin(), handles.end(), [&handle](const auto & other) {
+        return other.lock() == handle;
+      });
+    if (it == handles.end()) {
+      throw std::runtime_error("Filtered parameter callback doesn't exist");
+    }
+    handles.erase(it);
+    callbacks_->filtered_callbacks_by_node.clear();
+  }
+
+  /// \brief Call back on every parameter event of every node
+  std::shared_ptr<ParameterEventCallbackHandle> add_parameter_event_callback(
+    ParameterEventCallbackType callback)
+  {
+    auto handle = std::make_shared<ParameterEventCallbackHandle>();
+    handle->callback = std::move(callback);
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    callbacks_->event_callbacks.push_front(handle);
+    return handle;
+  }
+
+  /// \brief Stop calling back on parameter events
+  /// \throws std::runtime_error if the callback isn't there
+  void remove_parameter_event_callback(
+    const std::shared_ptr<ParameterEventCallbackHandle> & handle)
+  {
+    std::lock_guard<std::mutex> lock(callbacks_->mutex);
+    auto & handles = callbacks_->event_callbacks;
+    auto it = std::find_if(
+      handles.begin(), handles.end(), [&handle](const auto & other) {
+        return other.lock() == handle;
+      });
+    if (it == handles.end()) {
+      throw std::runtime_error("Parameter event callback doesn't exist");
+    }
+    handles.erase(it);
+  }
+
+  /// \brief Call the callbacks for an event, as the subscription does for every event
+  void event_callback(const rcl_interfaces::msg::ParameterEvent & event)
+  {
+    callbacks_->event_callback(event);
+  }
+
+private:
+  // Shared with the subscription's callback, which may outlive the handler.
+  struct Callbacks
+  {
+    using Handles = std::list<std::weak_ptr<ParameterCallbackHandle>>;
+
+    void event_callback(const rcl_interfaces::msg::ParameterEvent & event)
+    {
+      // The callbacks are called without holding on to the index, so that they may change it.
+      std::vector<std::pair<std::shared_ptr<ParameterCallbackHandle>,
+        const rcl_interfaces::msg::Parameter *>> matches;
+      std::vector<std::shared_ptr<FilteredParameterCallbackHandle>> filters;
+      std::vector<std::shared_ptr<ParameterEventCallbackHandle>> events;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!filtered_callbacks.empty()) {
+          for (const auto & handle : filters_of(event.node)) {
+            if (auto shared_handle = handle.lock()) {
+              filters.push_back(std::move(shared_handle));
+            }
+          }
+        }
+        auto node = parameter_callbacks.find(event.node);
+        if (node != parameter_callbacks.end()) {
+          for (const auto * parameters : {&event.new_parameters, &event.changed_parameters}) {
+            for (const auto & parameter : *parameters) {
+              auto it = node->second.find(parameter.name);
+              if (it == node->second.end()) {
+                continue;
+              }
+              for (auto handle = it->second.begin(); handle != it->second.end(); ) {
+                if (auto shared_handle = handle->lock()) {
+                  matches.emplace_back(std::move(shared_handle), &parameter);
+                  ++handle;
+                } else {
+                  handle = it->second.erase(handle);
+                }
+              }
+              if (it->second.empty()) {
+                node->second.erase(it);
+              }
+            }
+          }
+        }
+        for (auto handle = event_callbacks.begin(); handle != event_callbacks.end(); ) {
+          if (auto shared_handle = handle->lock()) {
+            events.push_back(std::move(shared_handle));
+            ++handle;
+          } else {
+            handle = event_callbacks.erase(handle);
+          }
+        }
+      }
+      for (const auto & [handle, parameter] : matches) {
+        handle->callback(rclcpp::Parameter::from_parameter_msg(*parameter));
+      }
+      if (!filters.empty()) {
+        for (const auto * parameters : {&event.new_parameters, &event.changed_parameters}) {
+          for (const auto & parameter : *parameters) {
+            std::optional<rclcpp::Parameter> converted;
+            for (const auto & filter : filters) {
+              if (filter->parameter_pattern.match(parameter.name)) {
+                if (!converted) {
+                  converted = rclcpp::Parameter::from_parameter_msg(parameter);
+                }
+                filter->callback(event.node, *converted);
+              }
+            }
+          }
+        }
+      }
+      for (const auto & handle : events) {
+        handle->callback(event);
+      }
+    }
+
+    std::mutex mutex;
+    // Node name to parameter name to the callbacks, the newest first.
+    std::unordered_map<std::string, std::unordered_map<std::string, Handles>>
+    parameter_callbacks;
+    std::list<std::weak_ptr<ParameterEventCallbackHandle>> event_callbacks;
+    // The filtered callbacks, the newest first, and for the nodes which had events since they
+    // last changed, those whose node pattern the node's name matches.
+    std::list<std::weak_ptr<FilteredParameterCallbackHandle>> filtered_callbacks;
+    std::unordered_map<std::string, std::vector<std::weak_ptr<FilteredParameterCallbackHandle>>>
+    filtered_callbacks_by_node;
+
+    // Called with mutex held.
+    const std::vector<std::weak_ptr<FilteredParameterCallbackHandle>> &
+    filters_of(const std::string & node_name)
+    {
+      auto it = filtered_callbacks_by_node.find(node_name);
+      if (it != filtered_callbacks_by_node.end()) {
+        return it->second;
+      }
+      std::vector<std::weak_ptr<FilteredParameterCallbackHandle>> filters;
+      for (auto handle = filtered_callbacks.begin(); handle != filtered_callbacks.end(); ) {
+        if (auto shared_handle = handle->lock()) {
+          if (shared_handle->node_pattern.match(node_name)) {
+            filters.push_back(*handle);
+          }
+          ++handle;
+        } else {
+          handle = filtered_callbacks.erase(handle);
+        }
+      }
+      return filtered_callbacks_by_node.emplace(node_name, std::move(filters)).first->second;
+    }
+  };
+
+  // Resolves a node name the way rclcpp::ParameterEventHandler does.
+  std::string resolve_path(const std::string & path) const
+  {
+    if (path.empty()) {
+      return node_base_->get_fully_qualified_name();
+    }
+    if (path.front() == '/') {
+      return path;
+    }
+    std::string ns = node_base_->get_namespace();
+    return ns == "/" ? "/" + path : ns + "/" + path;
+  }
+
+  rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_;
+  std::shared_ptr<Callbacks> callbacks_;
+  rclcpp::Subscription<rcl_interfaces::msg::ParameterEvent>::SharedPtr subscription_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__INDEXED_PARAMETER_EVENT_HANDLER_HPP_
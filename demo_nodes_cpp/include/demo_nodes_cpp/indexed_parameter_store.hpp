@@ -0,0 +1,289 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__INDEXED_PARAMETER_STORE_HPP_
+#define DEMO_NODES_CPP__INDEXED_PARAMETER_STORE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/list_parameters_result.hpp"
+#include "rcl_interfaces/msg/parameter.hpp"
+#include "rcl_interfaces/msg/parameter_descriptor.hpp"
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rcl_interfaces/msg/parameter_type.hpp"
+#include "rcl_interfaces/msg/parameter_value.hpp"
+#include "rcl_interfaces/msg/set_parameters_result.hpp"
+#include "rcl_interfaces/srv/list_parameters.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Parameters of a blackboard, kept sorted by name, so listing a prefix only visits the
+/// parameters under it: O(log n + k) for k results rather than a pass over all n parameters.
+/// It follows the rules of a node which allows undeclared parameters: getting or describing an
+/// unknown parameter yields an unset one, setting one creates it, with dynamic typing, and
+/// setting one to PARAMETER_NOT_SET deletes it.
+/// Every call is consistent on its own: reads share a lock and writes take it exclusively, so
+/// a read sees either all of the parameters of a set call, or none.
+class IndexedParameterStore final
+{
+public:
+  using ParameterValue = rcl_interfaces::msg::ParameterValue;
+  using ParameterType = rcl_interfaces::msg::ParameterType;
+  /// Gets the parameters a set call added, changed or deleted, if there are any, before the
+  /// call lets go of the lock, so that the events of concurrent set calls are passed on in the
+  /// order their changes were made.
+  using EventSink = std::function<void (rcl_interfaces::msg::ParameterEvent &)>;
+
+  /// \brief Add parameters, e.g. the overrides of the node, typed statically like declared ones
+  void declare(std::vector<rcl_interfaces::msg::Parameter> parameters)
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto & parameter : parameters) {
+      if (parameter.value.type != ParameterType::PARAMETER_NOT_SET) {
+        parameters_[parameter.name] = Entry{std::move(parameter.value), false};
+      }
+    }
+  }
+
+  /// \brief How many parameters there are
+  size_t size() const
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return parameters_.size();
+  }
+
+  std::vector<ParameterValue> get(const std::vector<std::string> & names) const
+  {
+    std::vector<ParameterValue> values(names.size());
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < names.size(); ++i) {
+      auto it = parameters_.find(names[i]);
+      if (it != parameters_.end()) {
+        values[i] = it->second.value;
+      }
+    }
+    return values;
+  }
+
+  std::vector<uint8_t> get_types(const std::vector<std::string> & names) const
+  {
+    std::vector<uint8_t> types(names.size(), ParameterType::PARAMETER_NOT_SET);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < names.size(); ++i) {
+      auto it = parameters_.find(names[i]);
+      if (it != parameters_.end()) {
+        types[i] = it->second.value.type;
+      }
+    }
+    return types;
+  }
+
+  std::vector<rcl_interfaces::msg::ParameterDescriptor> describe(
+    const std::vector<std::string> & names) const
+  {
+    std::vector<rcl_interfaces::msg::ParameterDescriptor> descriptors(names.size());
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < names.size(); ++i) {
+      descriptors[i].name = names[i];
+      auto it = parameters_.find(names[i]);
+      if (it != parameters_.end()) {
+        descriptors[i].type = it->second.value.type;
+        descriptors[i].dynamic_typing = it->second.dynamic_typing;
+      } else {
+        descriptors[i].dynamic_typing = true;
+      }
+    }
+    return descriptors;
+  }
+
+  /// \brief List parameters the way rclcpp::Node::list_parameters() does
+  /// \param prefixes Parameters named one of these, or under one, all if empty
+  /// \param depth How many levels below the prefixes to go, DEPTH_RECURSIVE for all
+  rcl_interfaces::msg::ListParametersResult list(
+    const std::vector<std::string> & prefixes, uint64_t depth) const
+  {
+    const bool recursive =
+      depth == rcl_interfaces::srv::ListParameters::Request::DEPTH_RECURSIVE;
+    rcl_interfaces::msg::ListParametersResult result;
+    std::unordered_set<std::string> seen_prefixes;
+    auto add = [&](const std::string & name) {
+        result.names.push_back(name);
+        size_t last_separator = name.find_last_of('.');
+        if (last_separator != std::string::npos) {
+          std::string prefix = name.substr(0, last_separator);
+          if (seen_prefixes.insert(prefix).second) {
+            result.prefixes.push_back(std::move(prefix));
+          }
+        }
+      };
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (prefixes.empty()) {
+      for (const auto & [name, entry] : parameters_) {
+        if (recursive || levels(name.begin(), name.end()) < depth) {
+          add(name);
+        }
+      }
+      return result;
+    }
+    // Overlapping prefixes, like "a" and "a.b", would list the parameters under both twice.
+    std::unordered_set<const std::string *> listed;
+    for (const std::string & prefix : prefixes) {
+      auto exact = parameters_.find(prefix);
+      if (exact != parameters_.end() &&
+        (prefixes.size() == 1 || listed.insert(&exact->first).second))
+      {
+        add(exact->first);
+      }
+      // The names under the prefix, "prefix.", sort before those starting with "prefix/".
+      // Their levels are counted from after the "prefix.".
+      auto it = parameters_.lower_bound(prefix + '.');
+      auto end = parameters_.lower_bound(prefix + '/');
+      for (; it != end; ++it) {
+        const std::string & name = it->first;
+        if (!recursive && levels(name.begin() + prefix.size() + 1, name.end()) >= depth) {
+          continue;
+        }
+        if (prefixes.size() == 1 || listed.insert(&name).second) {
+          add(name);
+        }
+      }
+    }
+    return result;
+  }
+
+  /// \brief Set parameters one by one, which makes some fail while others succeed
+  /// \param sink Gets the parameters which were added, changed or deleted
+  std::vector<rcl_interfaces::msg::SetParametersResult> set(
+    const std::vector<rcl_interfaces::msg::Parameter> & parameters,
+    const EventSink & sink = nullptr)
+  {
+    std::vector<rcl_interfaces::msg::SetParametersResult> results(parameters.size());
+    rcl_interfaces::msg::ParameterEvent event;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      results[i] = check(parameters[i]);
+      if (results[i].successful) {
+        apply(parameters[i], event);
+      }
+    }
+    pass_on(event, sink);
+    return results;
+  }
+
+  /// \brief Set all of the parameters, or none if any of them can't be set
+  /// \param sink Gets the parameters which were added, changed or deleted
+  rcl_interfaces::msg::SetParametersResult set_atomically(
+    const std::vector<rcl_interfaces::msg::Parameter> & parameters,
+    const EventSink & sink = nullptr)
+  {
+    rcl_interfaces::msg::ParameterEvent event;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto & parameter : parameters) {
+      auto result = check(parameter);
+      if (!result.successful) {
+        return result;
+      }
+    }
+    for (const auto & parameter : parameters) {
+      apply(parameter, event);
+    }
+    pass_on(event, sink);
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    return result;
+  }
+
+private:
+  struct Entry
+  {
+    ParameterValue value;
+    bool dynamic_typing = true;
+  };
+
+  static uint64_t levels(std::string::const_iterator begin, std::string::const_iterator end)
+  {
+    return static_cast<uint64_t>(std::count(begin, end, '.'));
+  }
+
+  // Called with the lock held exclusively.
+  rcl_interfaces::msg::SetParametersResult check(
+    const rcl_interfaces::msg::Parameter & parameter) const
+  {
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    if (parameter.name.empty()) {
+      result.successful = false;
+      result.reason = "parameter name must not be empty";
+      return result;
+    }
+    auto it = parameters_.find(parameter.name);
+    if (it != parameters_.end() && !it->second.dynamic_typing &&
+      parameter.value.type != ParameterType::PARAMETER_NOT_SET &&
+      parameter.value.type != it->second.value.type)
+    {
+      result.successful = false;
+      result.reason = "Wrong parameter type, parameter {" + parameter.name +
+        "} is statically typed";
+    }
+    return result;
+  }
+
+  // Called with the lock held exclusively.
+  static void pass_on(rcl_interfaces::msg::ParameterEvent & event, const EventSink & sink)
+  {
+    if (sink && (!event.new_parameters.empty() || !event.changed_parameters.empty() ||
+      !event.deleted_parameters.empty()))
+    {
+      sink(event);
+    }
+  }
+
+  // Called with the lock held exclusively.
+  void apply(
+    const rcl_interfaces::msg::Parameter & parameter,
+    rcl_interfaces::msg::ParameterEvent & event)
+  {
+    auto it = parameters_.find(parameter.name);
+    if (parameter.value.type == ParameterType::PARAMETER_NOT_SET) {
+      if (it != parameters_.end()) {
+        event.deleted_parameters.push_back(parameter);
+        parameters_.erase(it);
+      }
+    } else if (it == parameters_.end()) {
+      parameters_.emplace(parameter.name, Entry{parameter.value, true});
+      event.new_parameters.push_back(parameter);
+    } else {
+      it->second.value = parameter.value;
+      event.changed_parameters.push_back(parameter);
+    }
+  }
+
+  mutable std::shared_mutex mutex_;
+  std::map<std::string, Entry> parameters_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__INDEXED_PARAMETER_STORE_HPP_
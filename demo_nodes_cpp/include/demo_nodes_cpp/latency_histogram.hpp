@@ -0,0 +1,133 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__LATENCY_HISTOGRAM_HPP_
+#define DEMO_NODES_CPP__LATENCY_HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace demo_nodes_cpp
+{
+
+/// Histogram of latencies in nanoseconds, with a fixed number of buckets, so recording never
+/// allocates.
+/// Latencies below 2^kSubBits ns have a bucket each; above, every power of two is split into
+/// 2^kSubBits buckets, so percentiles are within 1/2^kSubBits (about 1.6%) of the real value.
+/// Negative latencies, from clocks which disagree, count as 0.
+class LatencyHistogram final
+{
+public:
+  /// \brief Add a latency
+  void record(int64_t ns)
+  {
+    uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    ++buckets_[bucket(value)];
+    ++count_;
+    max_ = std::max(max_, value);
+  }
+
+  /// \brief How many latencies were recorded
+  uint64_t count() const
+  {
+    return count_;
+  }
+
+  /// \brief The largest latency
+  uint64_t max() const
+  {
+    return max_;
+  }
+
+  /// \brief The latency which the given fraction of the recorded ones don't exceed
+  /// \param fraction Between 0 and 1, e.g. 0.99 for the 99th percentile
+  /// \return The upper end of the bucket holding that latency, 0 if nothing was recorded
+  uint64_t percentile(double fraction) const
+  {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(upper_bound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  /// \brief Add the latencies recorded by another histogram, e.g. one of another thread
+  void merge(const LatencyHistogram & other)
+  {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  /// \brief Forget everything recorded so far
+  void reset()
+  {
+    buckets_.fill(0);
+    count_ = 0;
+    max_ = 0;
+  }
+
+private:
+  static constexpr unsigned kSubBits = 6;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBits;
+  // Values up to 2^kMaxBits ns, about 18 minutes; larger ones go to the last bucket.
+  static constexpr unsigned kMaxBits = 40;
+  static constexpr size_t kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+
+  static size_t bucket(uint64_t value)
+  {
+    if (value < kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    if (value >> kMaxBits) {
+      return kBuckets - 1;
+    }
+    unsigned bits = kSubBits + 1;
+    while (value >> bits) {
+      ++bits;
+    }
+    // The top kSubBits + 1 bits of the value, of which the first is always set.
+    unsigned shift = bits - kSubBits - 1;
+    return static_cast<size_t>((shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets));
+  }
+
+  static uint64_t upper_bound(size_t index)
+  {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / kSubBuckets) - 1;
+    uint64_t top = kSubBuckets + index % kSubBuckets;
+    return ((top + 1) << shift) - 1;
+  }
+
+  std::array<uint64_t, kBuckets> buckets_{};
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__LATENCY_HISTOGRAM_HPP_
@@ -0,0 +1,389 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__MEMORY_RESOURCES_HPP_
+#define DEMO_NODES_CPP__MEMORY_RESOURCES_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+// Memory resources for the per-message allocations rclcpp makes through the allocator given to
+// a MessageMemoryStrategy and to the messages' deleters, e.g. via a
+// std::pmr::polymorphic_allocator<void> pointing at one of them.
+// They rely on the size given to deallocate(), so keep them out of the allocator of
+// PublisherOptionsWithAllocator and SubscriptionOptionsWithAllocator: rclcpp hands that one to
+// rcl, which frees its objects with a size of 1.
+// Like std::pmr::unsynchronized_pool_resource, none of them is thread-safe; give each executor
+// thread its own resource or guard it.
+
+namespace demo_nodes_cpp
+{
+
+/// Round up to a multiple of the given power of two.
+inline size_t align_up(size_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/// Blocks of a single size, carved out of one upstream allocation made up front.
+/// Requests which are larger or more aligned than a block, or which arrive while every block is
+/// taken, are passed on to the upstream resource and counted as fallbacks.
+class FixedPoolResource final : public std::pmr::memory_resource
+{
+public:
+  /// \brief Allocate the blocks
+  /// \param block_size The largest request served from the pool
+  /// \param blocks How many blocks to allocate
+  /// \param upstream Where the blocks and the fallbacks come from
+  FixedPoolResource(
+    size_t block_size, size_t blocks,
+    std::pmr::memory_resource * upstream = std::pmr::get_default_resource())
+  : block_size_(align_up(std::max(block_size, sizeof(Block)), alignof(std::max_align_t))),
+    storage_bytes_(block_size_ * blocks),
+    upstream_(upstream)
+  {
+    storage_ = static_cast<char *>(upstream_->allocate(storage_bytes_, alignof(std::max_align_t)));
+    for (size_t i = blocks; i > 0; --i) {
+      push(storage_ + (i - 1) * block_size_);
+    }
+  }
+
+  FixedPoolResource(const FixedPoolResource &) = delete;
+  FixedPoolResource & operator=(const FixedPoolResource &) = delete;
+
+  ~FixedPoolResource() override
+  {
+    upstream_->deallocate(storage_, storage_bytes_, alignof(std::max_align_t));
+  }
+
+  /// \brief How many requests were passed on to the upstream resource
+  size_t fallbacks() const
+  {
+    return fallbacks_;
+  }
+
+private:
+  struct Block
+  {
+    Block * next;
+  };
+
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    if (bytes <= block_size_ && alignment <= alignof(std::max_align_t) && free_ != nullptr) {
+      Block * block = free_;
+      free_ = block->next;
+      return block;
+    }
+    ++fallbacks_;
+    return upstream_->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    char * block = static_cast<char *>(p);
+    if (block >= storage_ && block < storage_ + storage_bytes_) {
+      push(block);
+    } else {
+      upstream_->deallocate(p, bytes, alignment);
+    }
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  void push(char * p)
+  {
+    Block * block = reinterpret_cast<Block *>(p);
+    block->next = free_;
+    free_ = block;
+  }
+
+  const size_t block_size_;
+  const size_t storage_bytes_;
+  std::pmr::memory_resource * upstream_;
+  char * storage_ = nullptr;
+  Block * free_ = nullptr;
+  size_t fallbacks_ = 0;
+};
+
+/// Power-of-two size classes from 16 bytes up to a maximum, each with its own free list.
+/// A size class whose free list is empty carves its blocks out of slabs it takes from the
+/// upstream resource; freed blocks go back to the free list of their class and slabs are only
+/// returned upstream when the resource is destroyed. Larger requests go straight upstream.
+class SlabResource final : public std::pmr::memory_resource
+{
+public:
+  static constexpr size_t min_block = 16;
+  static constexpr size_t num_classes = 12;
+
+  /// \brief Construct a resource without taking any memory yet
+  /// \param slab_bytes How much memory to take from upstream at once for a size class
+  /// \param max_block The largest request served from the slabs, at most 32 KiB
+  /// \param upstream Where the slabs and the large requests come from
+  explicit SlabResource(
+    size_t slab_bytes = 64 * 1024, size_t max_block = 4096,
+    std::pmr::memory_resource * upstream = std::pmr::get_default_resource())
+  : slab_bytes_(slab_bytes), upstream_(upstream)
+  {
+    while (classes_ < num_classes && (min_block << classes_) <= max_block) {
+      ++classes_;
+    }
+  }
+
+  SlabResource(const SlabResource &) = delete;
+  SlabResource & operator=(const SlabResource &) = delete;
+
+  ~SlabResource() override
+  {
+    while (slabs_ != nullptr) {
+      Slab * slab = slabs_;
+      slabs_ = slab->next;
+      upstream_->deallocate(slab, slab->bytes, alignof(std::max_align_t));
+    }
+  }
+
+  /// \brief How many bytes were taken from upstream for slabs
+  size_t slab_bytes_in_use() const
+  {
+    return slab_total_;
+  }
+
+private:
+  struct Block
+  {
+    Block * next;
+  };
+
+  struct Slab
+  {
+    Slab * next;
+    size_t bytes;
+  };
+
+  struct SizeClass
+  {
+    Block * free = nullptr;
+    // The part of the newest slab which was not handed out yet.
+    char * fresh = nullptr;
+    char * fresh_end = nullptr;
+  };
+
+  /// The size class serving the request, or classes_ if it is too large.
+  size_t size_class(size_t bytes) const
+  {
+    size_t index = 0;
+    while (index < classes_ && (min_block << index) < bytes) {
+      ++index;
+    }
+    return index;
+  }
+
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    size_t index = size_class(bytes);
+    if (index == classes_ || alignment > alignof(std::max_align_t)) {
+      return upstream_->allocate(bytes, alignment);
+    }
+    SizeClass & slot = size_classes_[index];
+    if (slot.free != nullptr) {
+      Block * block = slot.free;
+      slot.free = block->next;
+      return block;
+    }
+    size_t block_size = min_block << index;
+    if (slot.fresh == slot.fresh_end) {
+      // Carve at least a few blocks out of each slab, even for the largest class.
+      size_t header = align_up(sizeof(Slab), alignof(std::max_align_t));
+      size_t slab_bytes = std::max(slab_bytes_, header + 8 * block_size);
+      Slab * slab = static_cast<Slab *>(
+        upstream_->allocate(slab_bytes, alignof(std::max_align_t)));
+      slab->next = slabs_;
+      slab->bytes = slab_bytes;
+      slabs_ = slab;
+      slab_total_ += slab_bytes;
+      slot.fresh = reinterpret_cast<char *>(slab) + header;
+      slot.fresh_end = slot.fresh + (slab_bytes - header) / block_size * block_size;
+    }
+    void * block = slot.fresh;
+    slot.fresh += block_size;
+    return block;
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    size_t index = size_class(bytes);
+    if (index == classes_ || alignment > alignof(std::max_align_t)) {
+      upstream_->deallocate(p, bytes, alignment);
+      return;
+    }
+    Block * block = static_cast<Block *>(p);
+    block->next = size_classes_[index].free;
+    size_classes_[index].free = block;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  const size_t slab_bytes_;
+  std::pmr::memory_resource * upstream_;
+  size_t classes_ = 0;
+  std::array<SizeClass, num_classes> size_classes_{};
+  Slab * slabs_ = nullptr;
+  size_t slab_total_ = 0;
+};
+
+/// Bump allocator for the memory which only lives while a callback executes.
+/// Deallocation only counts the outstanding allocations; reset() rewinds the arena once all of
+/// them were returned, e.g. after every spin of the executor. The chunks taken from upstream
+/// are kept across resets, so after warming up an arena does not allocate at all.
+/// Give it only to the message paths (the messages' allocator and MessageMemoryStrategy): memory
+/// which stays allocated, like rcl's publishers or the executor's handle lists, would keep it
+/// from ever being reset.
+class CallbackArenaResource final : public std::pmr::memory_resource
+{
+public:
+  /// \brief Construct an arena
+  /// \param initial_bytes The size of the first chunk; later chunks double in size
+  /// \param upstream Where the chunks come from
+  explicit CallbackArenaResource(
+    size_t initial_bytes = 64 * 1024,
+    std::pmr::memory_resource * upstream = std::pmr::get_default_resource())
+  : initial_bytes_(initial_bytes), upstream_(upstream)
+  {
+  }
+
+  CallbackArenaResource(const CallbackArenaResource &) = delete;
+  CallbackArenaResource & operator=(const CallbackArenaResource &) = delete;
+
+  ~CallbackArenaResource() override
+  {
+    while (head_ != nullptr) {
+      Chunk * chunk = head_;
+      head_ = chunk->next;
+      upstream_->deallocate(chunk, chunk->bytes, alignof(std::max_align_t));
+    }
+  }
+
+  /// \brief Rewind the arena if nothing allocated from it is still in use
+  /// \return Whether the arena was rewound
+  bool reset()
+  {
+    if (outstanding_ != 0) {
+      ++deferred_resets_;
+      return false;
+    }
+    current_ = head_;
+    offset_ = header();
+    return true;
+  }
+
+  /// \brief How many calls to reset() found allocations still in use
+  size_t deferred_resets() const
+  {
+    return deferred_resets_;
+  }
+
+  /// \brief How many bytes were taken from upstream for chunks
+  size_t chunk_bytes() const
+  {
+    return chunk_total_;
+  }
+
+private:
+  struct Chunk
+  {
+    Chunk * next;
+    size_t bytes;
+  };
+
+  static size_t header()
+  {
+    return align_up(sizeof(Chunk), alignof(std::max_align_t));
+  }
+
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    while (true) {
+      if (current_ != nullptr) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(current_);
+        size_t offset = align_up(base + offset_, alignment) - base;
+        if (offset + bytes <= current_->bytes) {
+          offset_ = offset + bytes;
+          ++outstanding_;
+          return reinterpret_cast<char *>(current_) + offset;
+        }
+      }
+      next_chunk(bytes, alignment);
+    }
+  }
+
+  void do_deallocate(void *, size_t, size_t) override
+  {
+    --outstanding_;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  /// Move on to the next chunk, taking a new one from upstream if this was the last one or the
+  /// next one is too small.
+  void next_chunk(size_t bytes, size_t alignment)
+  {
+    size_t needed = header() + bytes + alignment;
+    if (current_ != nullptr && current_->next != nullptr && current_->next->bytes >= needed) {
+      current_ = current_->next;
+      offset_ = header();
+      return;
+    }
+    size_t chunk_bytes = std::max(needed, current_ ? 2 * current_->bytes : initial_bytes_);
+    Chunk * chunk = static_cast<Chunk *>(
+      upstream_->allocate(chunk_bytes, alignof(std::max_align_t)));
+    chunk->bytes = chunk_bytes;
+    chunk_total_ += chunk_bytes;
+    if (current_ == nullptr) {
+      chunk->next = head_;
+      head_ = chunk;
+    } else {
+      // Splice the chunk in after the current one, so it is reused in this order after a reset.
+      chunk->next = current_->next;
+      current_->next = chunk;
+    }
+    current_ = chunk;
+    offset_ = header();
+  }
+
+  const size_t initial_bytes_;
+  std::pmr::memory_resource * upstream_;
+  Chunk * head_ = nullptr;
+  Chunk * current_ = nullptr;
+  size_t offset_ = 0;
+  size_t outstanding_ = 0;
+  size_t deferred_resets_ = 0;
+  size_t chunk_total_ = 0;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__MEMORY_RESOURCES_HPP_
@@ -0,0 +1,142 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__PARAMETER_EVENT_COALESCER_HPP_
+#define DEMO_NODES_CPP__PARAMETER_EVENT_COALESCER_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter.hpp"
+#include "rcl_interfaces/msg/parameter_event.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Merges parameter events, so that all the changes a node made over a while go out as one
+/// event instead of one event per set call.
+/// Each parameter appears once in the merged event of its node, with the value it ended with,
+/// as new if it didn't exist before the first of the merged events, as deleted if it doesn't
+/// exist after the last one, and as changed otherwise; one which was added and deleted again
+/// doesn't appear at all.
+/// Events may be added from several threads.
+class ParameterEventCoalescer final
+{
+public:
+  /// \brief Merge an event into the one pending for its node
+  void add(const rcl_interfaces::msg::ParameterEvent & event)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(event.node);
+    if (it == index_.end()) {
+      it = index_.emplace(event.node, pending_.size()).first;
+      pending_.emplace_back();
+      pending_.back().node = event.node;
+    }
+    Pending & pending = pending_[it->second];
+    pending.stamp = event.stamp;
+    for (const auto & parameter : event.new_parameters) {
+      pending.merge(parameter, false, true);
+    }
+    for (const auto & parameter : event.changed_parameters) {
+      pending.merge(parameter, true, true);
+    }
+    for (const auto & parameter : event.deleted_parameters) {
+      pending.merge(parameter, true, false);
+    }
+  }
+
+  /// \brief Whether no events were added since the last take()
+  bool empty() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.empty();
+  }
+
+  /// \brief Take the merged events, one per node, leaving none pending
+  /// \return The events of the nodes whose parameters ended up different, in the order of the
+  ///   nodes' first events, each stamped with the stamp of the node's last event
+  std::vector<rcl_interfaces::msg::ParameterEvent> take()
+  {
+    std::vector<Pending> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending.swap(pending_);
+      index_.clear();
+    }
+    std::vector<rcl_interfaces::msg::ParameterEvent> events;
+    events.reserve(pending.size());
+    for (auto & node : pending) {
+      rcl_interfaces::msg::ParameterEvent event;
+      event.node = std::move(node.node);
+      event.stamp = node.stamp;
+      for (auto & change : node.changes) {
+        if (!change.existed_before && change.exists_after) {
+          event.new_parameters.push_back(std::move(change.parameter));
+        } else if (change.existed_before && change.exists_after) {
+          event.changed_parameters.push_back(std::move(change.parameter));
+        } else if (change.existed_before) {
+          event.deleted_parameters.push_back(std::move(change.parameter));
+        }
+      }
+      if (!event.new_parameters.empty() || !event.changed_parameters.empty() ||
+        !event.deleted_parameters.empty())
+      {
+        events.push_back(std::move(event));
+      }
+    }
+    return events;
+  }
+
+private:
+  struct Change
+  {
+    rcl_interfaces::msg::Parameter parameter;
+    bool existed_before;
+    bool exists_after;
+  };
+
+  // The changes to one node's parameters, in the order the parameters first changed.
+  struct Pending
+  {
+    void merge(const rcl_interfaces::msg::Parameter & parameter, bool existed, bool exists)
+    {
+      auto it = index.find(parameter.name);
+      if (it == index.end()) {
+        index.emplace(parameter.name, changes.size());
+        changes.push_back(Change{parameter, existed, exists});
+      } else {
+        changes[it->second].parameter = parameter;
+        changes[it->second].exists_after = exists;
+      }
+    }
+
+    std::string node;
+    rcl_interfaces::msg::ParameterEvent::_stamp_type stamp;
+    std::vector<Change> changes;
+    std::unordered_map<std::string, size_t> index;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<Pending> pending_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__PARAMETER_EVENT_COALESCER_HPP_
@@ -0,0 +1,130 @@
+// Copyright 2019 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__SERIALIZED_MESSAGE_POOL_HPP_
+#define DEMO_NODES_CPP__SERIALIZED_MESSAGE_POOL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/message_memory_strategy.hpp"
+#include "rclcpp/serialized_message.hpp"
+
+namespace demo_nodes_cpp
+{
+
+/// Serialized messages allocated up front and handed out again once they are returned.
+/// A buffer keeps the capacity it grew to, so in steady state neither the buffers nor their
+/// storage are allocated per message.
+class SerializedMessagePool final
+{
+public:
+  /// \brief Preallocate the messages
+  /// \param size How many messages to preallocate
+  /// \param capacity How many bytes to reserve in each message
+  SerializedMessagePool(size_t size, size_t capacity)
+  : capacity_(capacity)
+  {
+    free_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      free_.push_back(std::make_shared<rclcpp::SerializedMessage>(capacity));
+    }
+  }
+
+  /// \brief Take a message out of the pool, allocating one only if the pool is empty
+  /// \param capacity How many bytes the message needs to hold at least
+  std::shared_ptr<rclcpp::SerializedMessage> acquire(size_t capacity = 0)
+  {
+    std::shared_ptr<rclcpp::SerializedMessage> msg;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (free_.empty()) {
+        ++misses_;
+      } else {
+        msg = std::move(free_.back());
+        free_.pop_back();
+      }
+    }
+    if (!msg) {
+      return std::make_shared<rclcpp::SerializedMessage>(std::max(capacity, capacity_));
+    }
+    if (msg->capacity() < capacity) {
+      msg->reserve(capacity);
+    }
+    return msg;
+  }
+
+  /// \brief Hand a message back; it is only reused if nobody else holds on to it
+  void release(std::shared_ptr<rclcpp::SerializedMessage> & msg)
+  {
+    if (msg && msg.use_count() == 1) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(std::move(msg));
+    }
+    msg.reset();
+  }
+
+  /// \brief How many messages had to be allocated because the pool was empty
+  size_t misses() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+
+private:
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<rclcpp::SerializedMessage>> free_;
+  size_t misses_ = 0;
+};
+
+/// Message memory strategy which lends the serialized messages a subscription takes from a pool,
+/// instead of allocating a new one for every message.
+template<typename MessageT, typename Alloc = std::allocator<void>>
+class PooledMessageMemoryStrategy final
+  : public rclcpp::message_memory_strategy::MessageMemoryStrategy<MessageT, Alloc>
+{
+public:
+  explicit PooledMessageMemoryStrategy(std::shared_ptr<SerializedMessagePool> pool)
+  : pool_(std::move(pool))
+  {
+  }
+
+  std::shared_ptr<rclcpp::SerializedMessage> borrow_serialized_message(size_t capacity) override
+  {
+    return pool_->acquire(capacity);
+  }
+
+  std::shared_ptr<rclcpp::SerializedMessage> borrow_serialized_message() override
+  {
+    return pool_->acquire();
+  }
+
+  void return_serialized_message(std::shared_ptr<rclcpp::SerializedMessage> & serialized_msg)
+  override
+  {
+    pool_->release(serialized_msg);
+  }
+
+private:
+  std::shared_ptr<SerializedMessagePool> pool_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__SERIALIZED_MESSAGE_POOL_HPP_
@@ -0,0 +1,466 @@
+// Copyright 2023 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__SERVICE_EVENT_LOG_HPP_
+#define DEMO_NODES_CPP__SERVICE_EVENT_LOG_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A compact binary log of service introspection events, as published on the
+// <service>/_service_event topics, and the code to write and read it back.
+//
+// The file starts with a 16 byte header: the magic "SRVEVLOG", the format version and a byte
+// order mark, as everything is written in the byte order of the writer.
+// Records follow, each one a 48 byte header and a payload:
+//
+//   offset  size  field
+//        0     4  size of the record, header included
+//        4     1  kind: 0 names a service, 1 is an event
+//        5     1  event type, as in service_msgs/msg/ServiceEventInfo
+//        6     2  index of the service, in the order they were named
+//        8     8  stamp of the event, in ns
+//       16     8  when the event was recorded, in ns
+//       24     8  sequence number of the call
+//       32    16  GID of the client
+//       48     -  the name of the service, or the serialized event if contents are kept
+//
+// When the log is closed, an index is appended: the service names, and every
+// kIndexInterval-th event's recording time and offset, so a reader can start at a given time.
+// A footer of the index offset and the magic "SRVEVIDX" ends the file. A log whose writer
+// didn't close it has no index, and is read from the start up to its last complete record.
+
+namespace demo_nodes_cpp
+{
+
+/// The kinds of service_msgs/msg/ServiceEventInfo.
+enum class ServiceEventType : uint8_t
+{
+  RequestSent = 0,
+  RequestReceived = 1,
+  ResponseSent = 2,
+  ResponseReceived = 3,
+};
+
+/// The info at the start of every service event.
+struct ServiceEventInfo
+{
+  ServiceEventType event_type = ServiceEventType::RequestSent;
+  int64_t stamp_ns = 0;
+  std::array<uint8_t, 16> client_gid{};
+  int64_t sequence_number = 0;
+};
+
+/// \brief Read the info of a serialized service event, without deserializing the rest of it
+/// \param data The serialized message, encapsulation header included
+/// \return false if the message isn't plain little or big endian CDR, or is too short
+inline bool parse_service_event_info(const uint8_t * data, size_t size, ServiceEventInfo & info)
+{
+  // uint8 event_type, int32 sec and uint32 nanosec at 4, char[16] client_gid at 12 and
+  // int64 sequence_number at 32, counting from after the 4 byte encapsulation header.
+  constexpr size_t kInfoSize = 40;
+  if (size < 4 + kInfoSize || data[0] != 0 || data[1] > 1) {
+    return false;
+  }
+  const uint16_t probe = 1;
+  const bool swap = (data[1] == 1) != (*reinterpret_cast<const uint8_t *>(&probe) == 1);
+  auto read = [data, swap](size_t offset, auto & value) {
+      uint8_t bytes[sizeof(value)];
+      std::memcpy(bytes, data + 4 + offset, sizeof(value));
+      if (swap) {
+        std::reverse(bytes, bytes + sizeof(value));
+      }
+      std::memcpy(&value, bytes, sizeof(value));
+    };
+  if (data[4] > static_cast<uint8_t>(ServiceEventType::ResponseReceived)) {
+    return false;
+  }
+  info.event_type = static_cast<ServiceEventType>(data[4]);
+  int32_t sec;
+  uint32_t nanosec;
+  read(4, sec);
+  read(8, nanosec);
+  info.stamp_ns = static_cast<int64_t>(sec) * 1000000000 + nanosec;
+  std::memcpy(info.client_gid.data(), data + 4 + 12, info.client_gid.size());
+  read(32, info.sequence_number);
+  return true;
+}
+
+namespace service_event_log
+{
+
+constexpr char kMagic[8] = {'S', 'R', 'V', 'E', 'V', 'L', 'O', 'G'};
+constexpr char kIndexMagic[8] = {'S', 'R', 'V', 'E', 'V', 'I', 'D', 'X'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr size_t kFileHeaderSize = 16;
+constexpr size_t kRecordHeaderSize = 48;
+constexpr size_t kFooterSize = 16;
+constexpr uint64_t kIndexInterval = 1024;
+constexpr uint8_t kServiceRecord = 0;
+constexpr uint8_t kEventRecord = 1;
+
+struct IndexEntry
+{
+  int64_t received_ns;
+  uint64_t offset;
+};
+
+}  // namespace service_event_log
+
+/// Appends service events to a log. Records go through a large stdio buffer, so appending an
+/// event is a copy in the common case, and a write() every so many of them.
+class ServiceEventLogWriter final
+{
+public:
+  /// \brief Create the log, replacing any file of that name
+  /// \param buffer_size How many bytes to collect before writing them to the file
+  /// \throws std::runtime_error if the file can't be created
+  explicit ServiceEventLogWriter(const std::string & path, size_t buffer_size = 1 << 20)
+  : buffer_(buffer_size)
+  {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      throw std::runtime_error("can't create '" + path + "'");
+    }
+    std::setvbuf(file_, buffer_.data(), _IOFBF, buffer_.size());
+    uint8_t header[service_event_log::kFileHeaderSize];
+    std::memcpy(header, service_event_log::kMagic, 8);
+    std::memcpy(header + 8, &service_event_log::kVersion, 4);
+    std::memcpy(header + 12, &service_event_log::kByteOrderMark, 4);
+    write(header, sizeof(header));
+  }
+
+  /// Write the index and close the file.
+  ~ServiceEventLogWriter()
+  {
+    uint64_t index_offset = offset_;
+    uint32_t count = static_cast<uint32_t>(services_.size());
+    write(&count, sizeof(count));
+    for (const std::string & name : services_) {
+      uint32_t length = static_cast<uint32_t>(name.size());
+      write(&length, sizeof(length));
+      write(name.data(), name.size());
+    }
+    uint64_t entries = index_.size();
+    write(&entries, sizeof(entries));
+    for (const auto & entry : index_) {
+      write(&entry.received_ns, sizeof(entry.received_ns));
+      write(&entry.offset, sizeof(entry.offset));
+    }
+    write(&index_offset, sizeof(index_offset));
+    write(service_event_log::kIndexMagic, 8);
+    std::fclose(file_);
+  }
+
+  ServiceEventLogWriter(const ServiceEventLogWriter &) = delete;
+  ServiceEventLogWriter & operator=(const ServiceEventLogWriter &) = delete;
+
+  /// \brief Name the service whose events come next
+  /// \return The index to append its events with
+  uint16_t add_service(const std::string & name)
+  {
+    uint16_t service = static_cast<uint16_t>(services_.size());
+    services_.push_back(name);
+    write_record(
+      service_event_log::kServiceRecord, service, ServiceEventInfo(), 0,
+      reinterpret_cast<const uint8_t *>(name.data()), name.size());
+    return service;
+  }
+
+  /// \brief Append a serialized service event
+  /// \param service The index add_service() returned
+  /// \param received_ns When the event was received
+  /// \param keep_contents Whether to store the whole event, rather than just its info
+  /// \return false, appending nothing, if the event couldn't be parsed
+  bool append(
+    uint16_t service, int64_t received_ns, const uint8_t * data, size_t size,
+    bool keep_contents)
+  {
+    ServiceEventInfo info;
+    if (!parse_service_event_info(data, size, info)) {
+      return false;
+    }
+    if (events_ % service_event_log::kIndexInterval == 0) {
+      index_.push_back({received_ns, offset_});
+    }
+    ++events_;
+    write_record(
+      service_event_log::kEventRecord, service, info, received_ns, data,
+      keep_contents ? size : 0);
+    return true;
+  }
+
+  /// \brief Hand everything appended so far to the operating system
+  void flush()
+  {
+    std::fflush(file_);
+  }
+
+  /// \brief How many events were appended
+  uint64_t events() const
+  {
+    return events_;
+  }
+
+  /// \brief How many bytes were written, or are about to be
+  uint64_t bytes() const
+  {
+    return offset_;
+  }
+
+private:
+  void write_record(
+    uint8_t kind, uint16_t service, const ServiceEventInfo & info, int64_t received_ns,
+    const uint8_t * payload, size_t payload_size)
+  {
+    uint8_t header[service_event_log::kRecordHeaderSize];
+    uint32_t size = static_cast<uint32_t>(sizeof(header) + payload_size);
+    std::memcpy(header, &size, 4);
+    header[4] = kind;
+    header[5] = static_cast<uint8_t>(info.event_type);
+    std::memcpy(header + 6, &service, 2);
+    std::memcpy(header + 8, &info.stamp_ns, 8);
+    std::memcpy(header + 16, &received_ns, 8);
+    std::memcpy(header + 24, &info.sequence_number, 8);
+    std::memcpy(header + 32, info.client_gid.data(), 16);
+    write(header, sizeof(header));
+    write(payload, payload_size);
+  }
+
+  void write(const void * data, size_t size)
+  {
+    if (size > 0) {
+      std::fwrite(data, 1, size, file_);
+      offset_ += size;
+    }
+  }
+
+  std::vector<char> buffer_;
+  std::FILE * file_ = nullptr;
+  uint64_t offset_ = 0;
+  uint64_t events_ = 0;
+  std::vector<std::string> services_;
+  std::vector<service_event_log::IndexEntry> index_;
+};
+
+/// One event read back from a log.
+struct ServiceEventRecord
+{
+  uint16_t service = 0;
+  ServiceEventInfo info;
+  int64_t received_ns = 0;
+  /// The serialized event, if the writer kept it, else empty.
+  std::vector<uint8_t> contents;
+};
+
+/// Reads the events of a log in the order they were recorded.
+class ServiceEventLogReader final
+{
+public:
+  /// \brief Open a log, and read its index if it has one
+  /// \throws std::runtime_error if the file can't be opened or isn't a log of this version
+  explicit ServiceEventLogReader(const std::string & path)
+  {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (file_ == nullptr) {
+      throw std::runtime_error("can't open '" + path + "'");
+    }
+    uint8_t header[service_event_log::kFileHeaderSize];
+    uint32_t version = 0;
+    uint32_t byte_order = 0;
+    if (std::fread(header, 1, sizeof(header), file_) == sizeof(header)) {
+      std::memcpy(&version, header + 8, 4);
+      std::memcpy(&byte_order, header + 12, 4);
+    }
+    if (std::memcmp(header, service_event_log::kMagic, 8) != 0 ||
+      version != service_event_log::kVersion ||
+      byte_order != service_event_log::kByteOrderMark)
+    {
+      std::fclose(file_);
+      throw std::runtime_error("'" + path + "' isn't a service event log this build can read");
+    }
+    std::fseek(file_, 0, SEEK_END);
+    end_ = static_cast<uint64_t>(std::ftell(file_));
+    read_index();
+    std::fseek(file_, service_event_log::kFileHeaderSize, SEEK_SET);
+    offset_ = service_event_log::kFileHeaderSize;
+  }
+
+  ~ServiceEventLogReader()
+  {
+    std::fclose(file_);
+  }
+
+  ServiceEventLogReader(const ServiceEventLogReader &) = delete;
+  ServiceEventLogReader & operator=(const ServiceEventLogReader &) = delete;
+
+  /// \brief Whether the log was closed properly, and so can be seeked
+  bool indexed() const
+  {
+    return indexed_;
+  }
+
+  /// \brief The names of the services, by index
+  /// Without an index, only those named by the records read so far.
+  const std::vector<std::string> & services() const
+  {
+    return services_;
+  }
+
+  /// \brief When the first event was recorded, or 0 if it isn't known without reading on
+  int64_t first_received_ns() const
+  {
+    return index_.empty() ? 0 : index_.front().received_ns;
+  }
+
+  /// \brief Move to an indexed event recorded no later than the given time, if there is one
+  /// Reading on from there yields every event recorded from then on, and a few before.
+  void seek(int64_t received_ns)
+  {
+    auto it = std::upper_bound(
+      index_.begin(), index_.end(), received_ns,
+      [](int64_t time, const service_event_log::IndexEntry & entry) {
+        return time < entry.received_ns;
+      });
+    if (it == index_.begin()) {
+      return;
+    }
+    offset_ = std::prev(it)->offset;
+    std::fseek(file_, static_cast<long>(offset_), SEEK_SET);  // NOLINT(runtime/int)
+  }
+
+  /// \brief Read the next event
+  /// \return false at the end of the log, or at a record which was cut short
+  bool next(ServiceEventRecord & record)
+  {
+    while (true) {
+      uint8_t header[service_event_log::kRecordHeaderSize];
+      if (end_ - offset_ < sizeof(header) ||
+        std::fread(header, 1, sizeof(header), file_) != sizeof(header))
+      {
+        return false;
+      }
+      uint32_t size;
+      std::memcpy(&size, header, 4);
+      if (size < sizeof(header) || end_ - offset_ < size) {
+        return false;
+      }
+      offset_ += size;
+      size_t payload_size = size - sizeof(header);
+      if (header[4] == service_event_log::kServiceRecord) {
+        std::string name(payload_size, '\0');
+        if (std::fread(&name[0], 1, payload_size, file_) != payload_size) {
+          return false;
+        }
+        uint16_t service;
+        std::memcpy(&service, header + 6, 2);
+        if (service >= services_.size()) {
+          services_.resize(service + 1u);
+          services_[service] = std::move(name);
+        }
+        continue;
+      }
+      if (header[4] != service_event_log::kEventRecord) {
+        // A kind of record a later version added.
+        std::fseek(file_, static_cast<long>(offset_), SEEK_SET);  // NOLINT(runtime/int)
+        continue;
+      }
+      record.info.event_type = static_cast<ServiceEventType>(header[5]);
+      std::memcpy(&record.service, header + 6, 2);
+      std::memcpy(&record.info.stamp_ns, header + 8, 8);
+      std::memcpy(&record.received_ns, header + 16, 8);
+      std::memcpy(&record.info.sequence_number, header + 24, 8);
+      std::memcpy(record.info.client_gid.data(), header + 32, 16);
+      record.contents.resize(payload_size);
+      return payload_size == 0 ||
+             std::fread(record.contents.data(), 1, payload_size, file_) == payload_size;
+    }
+  }
+
+private:
+  void read_index()
+  {
+    using service_event_log::kFooterSize;
+    uint8_t footer[kFooterSize];
+    if (end_ < service_event_log::kFileHeaderSize + kFooterSize) {
+      return;
+    }
+    std::fseek(file_, static_cast<long>(end_ - kFooterSize), SEEK_SET);  // NOLINT(runtime/int)
+    uint64_t index_offset;
+    if (std::fread(footer, 1, kFooterSize, file_) != kFooterSize ||
+      std::memcmp(footer + 8, service_event_log::kIndexMagic, 8) != 0)
+    {
+      return;
+    }
+    std::memcpy(&index_offset, footer, 8);
+    if (index_offset < service_event_log::kFileHeaderSize || index_offset > end_ - kFooterSize) {
+      return;
+    }
+    std::fseek(file_, static_cast<long>(index_offset), SEEK_SET);  // NOLINT(runtime/int)
+    std::vector<std::string> services;
+    std::vector<service_event_log::IndexEntry> index;
+    uint32_t count;
+    if (std::fread(&count, sizeof(count), 1, file_) != 1) {
+      return;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t length;
+      if (std::fread(&length, sizeof(length), 1, file_) != 1 || length > end_) {
+        return;
+      }
+      std::string name(length, '\0');
+      if (length > 0 && std::fread(&name[0], 1, length, file_) != length) {
+        return;
+      }
+      services.push_back(std::move(name));
+    }
+    uint64_t entries;
+    if (std::fread(&entries, sizeof(entries), 1, file_) != 1 || entries > end_) {
+      return;
+    }
+    index.resize(entries);
+    for (auto & entry : index) {
+      if (std::fread(&entry.received_ns, sizeof(entry.received_ns), 1, file_) != 1 ||
+        std::fread(&entry.offset, sizeof(entry.offset), 1, file_) != 1)
+      {
+        return;
+      }
+    }
+    services_ = std::move(services);
+    index_ = std::move(index);
+    end_ = index_offset;
+    indexed_ = true;
+  }
+
+  std::FILE * file_ = nullptr;
+  uint64_t offset_ = 0;
+  uint64_t end_ = 0;
+  bool indexed_ = false;
+  std::vector<std::string> services_;
+  std::vector<service_event_log::IndexEntry> index_;
+};
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__SERVICE_EVENT_LOG_HPP_
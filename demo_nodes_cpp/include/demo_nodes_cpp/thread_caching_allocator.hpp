@@ -0,0 +1,499 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__THREAD_CACHING_ALLOCATOR_HPP_
+#define DEMO_NODES_CPP__THREAD_CACHING_ALLOCATOR_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace demo_nodes_cpp
+{
+
+/// Memory behind ThreadCachingAllocator, safe to use from any number of threads.
+/// Every thread allocates from a cache of its own: one free list per power-of-two size class,
+/// refilled from chunks which belong to that cache. A block freed by the thread owning its chunk
+/// goes straight back onto the free list; a block freed by any other thread is pushed onto a
+/// lock-free queue of the owning cache, which the owner drains once its free list runs dry.
+/// So neither allocation nor deallocation takes a lock once a thread is warmed up.
+/// Deallocation does not rely on the size it is given, since rcl frees with a size of 1: a block
+/// whose chunk is in the heap's table of chunks takes its class from the chunk's header, and any
+/// other block is a large allocation, which has a header of its own in front of it.
+/// Memory is bounded: allocations which would take more than max_bytes from the system in total
+/// throw std::bad_alloc. Chunks are only returned to the system when the heap is destroyed, and
+/// the cache of a thread which exits is handed on to the next thread that needs one.
+class ThreadCachingHeap final
+{
+public:
+  static constexpr size_t min_block = 16;
+  static constexpr size_t num_classes = 8;
+  /// Chunks are aligned to their size, so the chunk of a block is found by masking its address.
+  static constexpr size_t chunk_bytes = 64 * 1024;
+
+  /// Totals across all caches.
+  struct Stats
+  {
+    size_t caches = 0;
+    /// Bytes taken from the system, for chunks and for requests larger than the size classes.
+    size_t reserved_bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t local_frees = 0;
+    uint64_t remote_frees = 0;
+    uint64_t large_allocations = 0;
+  };
+
+  /// \brief Construct a heap without taking any memory yet
+  /// \param max_bytes How many bytes the heap may take from the system at most
+  explicit ThreadCachingHeap(size_t max_bytes = 256 * 1024 * 1024)
+  : max_bytes_(max_bytes), id_(next_id())
+  {
+    // At most half full, so that lookups of an address which isn't in it end quickly.
+    size_t slots = 2;
+    while (slots < 2 * (max_bytes / chunk_bytes + 1)) {
+      slots *= 2;
+      ++chunk_table_bits_;
+    }
+    chunk_table_ = std::make_unique<std::atomic<uintptr_t>[]>(slots);
+    for (size_t i = 0; i < slots; ++i) {
+      chunk_table_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  ThreadCachingHeap(const ThreadCachingHeap &) = delete;
+  ThreadCachingHeap & operator=(const ThreadCachingHeap &) = delete;
+
+  /// Every block must have been returned and no thread may use the heap anymore.
+  ~ThreadCachingHeap()
+  {
+    for (void * chunk : chunks_) {
+      std::free(chunk);
+    }
+  }
+
+  /// \brief The heap used by default constructed allocators; it lives until the process exits
+  static ThreadCachingHeap & default_heap()
+  {
+    // Never destroyed, so threads still running at exit can keep freeing into it.
+    static ThreadCachingHeap * heap = new ThreadCachingHeap();
+    return *heap;
+  }
+
+  void * allocate(size_t bytes, size_t alignment)
+  {
+    size_t index = size_class(bytes);
+    if (index == num_classes || alignment > min_block) {
+      return allocate_large(bytes, alignment);
+    }
+    Cache & cache = local_cache();
+    bump(cache.allocations);
+    Block * block = cache.free[index];
+    if (block == nullptr) {
+      drain_remote(cache);
+      block = cache.free[index];
+    }
+    if (block != nullptr) {
+      cache.free[index] = block->next;
+      return block;
+    }
+    return carve(cache, index);
+  }
+
+  /// The size and alignment are only there to match allocate(); the headers are used instead.
+  void deallocate(void * p, size_t, size_t)
+  {
+    if (p == nullptr) {
+      return;
+    }
+    Chunk * chunk = chunk_of(p);
+    if (!is_chunk(chunk)) {
+      LargeHeader * header =
+        reinterpret_cast<LargeHeader *>(static_cast<char *>(p) - sizeof(LargeHeader));
+      reserved_.fetch_sub(header->bytes, std::memory_order_relaxed);
+      std::free(header->base);
+      return;
+    }
+    size_t index = chunk->index;
+    Block * block = static_cast<Block *>(p);
+    Cache * owner = chunk->owner;
+    if (owner == bound_cache()) {
+      block->next = owner->free[index];
+      owner->free[index] = block;
+      bump(owner->local_frees);
+      return;
+    }
+    // Treiber stack push; the owner takes the whole stack at once, so there is no ABA problem.
+    Block * head = owner->remote.load(std::memory_order_relaxed);
+    do {
+      block->next = head;
+    } while (!owner->remote.compare_exchange_weak(
+      head, block, std::memory_order_release, std::memory_order_relaxed));
+    owner->remote_frees.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// \brief Sum up the counters of all caches; they may be slightly behind while threads run
+  Stats stats() const
+  {
+    Stats stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.caches = caches_.size();
+    stats.reserved_bytes = reserved_.load(std::memory_order_relaxed);
+    stats.large_allocations = large_allocations_.load(std::memory_order_relaxed);
+    for (const auto & cache : caches_) {
+      stats.allocations += cache->allocations.load(std::memory_order_relaxed);
+      stats.local_frees += cache->local_frees.load(std::memory_order_relaxed);
+      stats.remote_frees += cache->remote_frees.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
+private:
+  struct Block
+  {
+    Block * next;
+  };
+
+  struct Cache
+  {
+    std::array<Block *, num_classes> free{};
+    // The part of the newest chunk of each class which was not handed out yet.
+    std::array<char *, num_classes> fresh{};
+    std::array<char *, num_classes> fresh_end{};
+    /// Blocks of this cache freed by other threads.
+    std::atomic<Block *> remote{nullptr};
+    /// Whether a thread uses the cache; it is up for adoption otherwise.
+    std::atomic<bool> owned{true};
+    // Only written by the owning thread, except remote_frees.
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> local_frees{0};
+    std::atomic<uint64_t> remote_frees{0};
+  };
+
+  struct Chunk
+  {
+    Cache * owner;
+    size_t index;
+  };
+
+  /// Right in front of a large allocation.
+  struct LargeHeader
+  {
+    /// What the system returned, which is freed again.
+    void * base;
+    /// The bytes taken from the system.
+    size_t bytes;
+  };
+
+  /// The caches the calling thread uses, one per heap; released when the thread exits.
+  struct Bindings
+  {
+    struct Binding
+    {
+      uint64_t heap = 0;
+      std::shared_ptr<Cache> cache;
+    };
+
+    ~Bindings()
+    {
+      for (auto & binding : slots) {
+        if (binding.cache) {
+          binding.cache->owned.store(false, std::memory_order_release);
+        }
+      }
+    }
+
+    std::array<Binding, 4> slots;
+    size_t next_eviction = 0;
+  };
+
+  static uint64_t next_id()
+  {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+  }
+
+  static size_t size_class(size_t bytes)
+  {
+    size_t index = 0;
+    while (index < num_classes && (min_block << index) < bytes) {
+      ++index;
+    }
+    return index;
+  }
+
+  /// Increment a counter only its owner writes to, without a locked instruction.
+  static void bump(std::atomic<uint64_t> & counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  static Chunk * chunk_of(void * p)
+  {
+    return reinterpret_cast<Chunk *>(reinterpret_cast<uintptr_t>(p) & ~(chunk_bytes - 1));
+  }
+
+  static Bindings & bindings()
+  {
+    thread_local Bindings bindings;
+    return bindings;
+  }
+
+  Cache * bound_cache() const
+  {
+    for (auto & binding : bindings().slots) {
+      if (binding.heap == id_) {
+        return binding.cache.get();
+      }
+    }
+    return nullptr;
+  }
+
+  Cache & local_cache()
+  {
+    Cache * cache = bound_cache();
+    return cache != nullptr ? *cache : bind();
+  }
+
+  /// Give the calling thread a cache, adopting one a finished thread left behind if possible.
+  Cache & bind()
+  {
+    std::shared_ptr<Cache> cache;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto & candidate : caches_) {
+        bool owned = false;
+        if (candidate->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+          cache = candidate;
+          break;
+        }
+      }
+      if (!cache) {
+        cache = std::make_shared<Cache>();
+        caches_.push_back(cache);
+      }
+    }
+    Bindings & local = bindings();
+    Bindings::Binding * slot = nullptr;
+    for (auto & binding : local.slots) {
+      if (!binding.cache) {
+        slot = &binding;
+        break;
+      }
+    }
+    if (slot == nullptr) {
+      // Using more heaps than slots; the evicted cache is adopted again when needed.
+      slot = &local.slots[local.next_eviction++ % local.slots.size()];
+      slot->cache->owned.store(false, std::memory_order_release);
+    }
+    slot->heap = id_;
+    slot->cache = cache;
+    return *cache;
+  }
+
+  void drain_remote(Cache & cache)
+  {
+    Block * block = cache.remote.exchange(nullptr, std::memory_order_acquire);
+    while (block != nullptr) {
+      Block * next = block->next;
+      // Blocks of every class share the queue; each chunk holds blocks of one class.
+      size_t index = chunk_of(block)->index;
+      block->next = cache.free[index];
+      cache.free[index] = block;
+      block = next;
+    }
+  }
+
+  void * carve(Cache & cache, size_t index)
+  {
+    size_t block_size = min_block << index;
+    if (cache.fresh[index] == cache.fresh_end[index]) {
+      char * chunk = static_cast<char *>(reserve(chunk_bytes, chunk_bytes));
+      *reinterpret_cast<Chunk *>(chunk) = Chunk{&cache, index};
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_.push_back(chunk);
+        add_chunk(chunk);
+      }
+      // The first block of the chunk holds its header.
+      cache.fresh[index] = chunk + std::max(block_size, sizeof(Chunk));
+      cache.fresh_end[index] = chunk + chunk_bytes;
+    }
+    void * block = cache.fresh[index];
+    cache.fresh[index] += block_size;
+    return block;
+  }
+
+  /// Memory of its own from the system, with a LargeHeader in front of the block.
+  void * allocate_large(size_t bytes, size_t alignment)
+  {
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    size_t offset = round_up(sizeof(LargeHeader), alignment);
+    size_t total = round_up(offset + bytes, alignment);
+    char * base = static_cast<char *>(reserve(total, alignment));
+    char * block = base + offset;
+    *reinterpret_cast<LargeHeader *>(block - sizeof(LargeHeader)) = LargeHeader{base, total};
+    large_allocations_.fetch_add(1, std::memory_order_relaxed);
+    return block;
+  }
+
+  static size_t round_up(size_t bytes, size_t alignment)
+  {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+  }
+
+  size_t chunk_slot(uintptr_t chunk) const
+  {
+    return static_cast<size_t>(
+      (chunk / chunk_bytes * 0x9E3779B97F4A7C15ULL) >> (64 - chunk_table_bits_));
+  }
+
+  /// Enter a chunk into the table; called with mutex_ held.
+  void add_chunk(void * chunk)
+  {
+    uintptr_t address = reinterpret_cast<uintptr_t>(chunk);
+    size_t mask = (size_t{1} << chunk_table_bits_) - 1;
+    size_t slot = chunk_slot(address);
+    while (chunk_table_[slot].load(std::memory_order_relaxed) != 0) {
+      slot = (slot + 1) & mask;
+    }
+    chunk_table_[slot].store(address, std::memory_order_release);
+  }
+
+  /// Whether the address is that of one of the chunks, without taking a lock.
+  bool is_chunk(const Chunk * chunk) const
+  {
+    uintptr_t address = reinterpret_cast<uintptr_t>(chunk);
+    size_t mask = (size_t{1} << chunk_table_bits_) - 1;
+    for (size_t slot = chunk_slot(address); ; slot = (slot + 1) & mask) {
+      uintptr_t entry = chunk_table_[slot].load(std::memory_order_acquire);
+      if (entry == address) {
+        return true;
+      }
+      if (entry == 0) {
+        return false;
+      }
+    }
+  }
+
+  /// Take memory from the system, within the budget; bytes is a multiple of the alignment.
+  void * reserve(size_t bytes, size_t alignment)
+  {
+    if (reserved_.fetch_add(bytes, std::memory_order_relaxed) + bytes > max_bytes_) {
+      reserved_.fetch_sub(bytes, std::memory_order_relaxed);
+      throw std::bad_alloc();
+    }
+    void * p = alignment <= alignof(std::max_align_t) ?
+      std::malloc(bytes) :
+      std::aligned_alloc(alignment, bytes);
+    if (p == nullptr) {
+      reserved_.fetch_sub(bytes, std::memory_order_relaxed);
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  const size_t max_bytes_;
+  const uint64_t id_;
+  std::atomic<size_t> reserved_{0};
+  std::atomic<uint64_t> large_allocations_{0};
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Cache>> caches_;
+  std::vector<void *> chunks_;
+  // Every chunk's address, for deallocate() to tell blocks of chunks from large ones.
+  std::unique_ptr<std::atomic<uintptr_t>[]> chunk_table_;
+  unsigned chunk_table_bits_ = 1;
+};
+
+/// Allocator for rclcpp which can be shared by publishers, subscriptions and executors running on
+/// any number of threads, backed by a ThreadCachingHeap.
+template<typename T = void>
+class ThreadCachingAllocator
+{
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using difference_type = typename std::pointer_traits<pointer>::difference_type;
+
+  /// \brief Allocate from the default heap
+  ThreadCachingAllocator() noexcept
+  : heap_(&ThreadCachingHeap::default_heap())
+  {
+  }
+
+  /// \brief Allocate from the given heap, which has to outlive every copy of the allocator
+  explicit ThreadCachingAllocator(ThreadCachingHeap & heap) noexcept
+  : heap_(&heap)
+  {
+  }
+
+  template<typename U>
+  ThreadCachingAllocator(const ThreadCachingAllocator<U> & other) noexcept
+  : heap_(&other.heap())
+  {
+  }
+
+  T * allocate(size_t size, const void * = 0)
+  {
+    return static_cast<T *>(heap_->allocate(size * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T * ptr, size_t size)
+  {
+    heap_->deallocate(ptr, size * sizeof(T), alignof(T));
+  }
+
+  ThreadCachingHeap & heap() const
+  {
+    return *heap_;
+  }
+
+  template<typename U>
+  struct rebind
+  {
+    typedef ThreadCachingAllocator<U> other;
+  };
+
+private:
+  // A plain pointer, since rclcpp copies allocators on hot paths.
+  ThreadCachingHeap * heap_;
+};
+
+template<typename T, typename U>
+bool operator==(
+  const ThreadCachingAllocator<T> & a,
+  const ThreadCachingAllocator<U> & b) noexcept
+{
+  return &a.heap() == &b.heap();
+}
+
+template<typename T, typename U>
+bool operator!=(
+  const ThreadCachingAllocator<T> & a,
+  const ThreadCachingAllocator<U> & b) noexcept
+{
+  return !(a == b);
+}
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__THREAD_CACHING_ALLOCATOR_HPP_
@@ -0,0 +1,107 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMO_NODES_CPP__WORKER_POOL_HPP_
+#define DEMO_NODES_CPP__WORKER_POOL_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace demo_nodes_cpp
+{
+
+/// Threads which run tasks handed to them, e.g. the work of service requests whose responses
+/// are deferred, so the executor's threads are free to take the next requests meanwhile.
+/// Tasks which are still queued when the pool is destroyed are dropped.
+class WorkerPool final
+{
+public:
+  /// \brief Start the threads
+  /// \param threads How many threads to run tasks on
+  explicit WorkerPool(size_t threads)
+  {
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back([this]() {run();});
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_all();
+    for (auto & thread : threads_) {
+      thread.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool & operator=(const WorkerPool &) = delete;
+
+  /// \brief Queue a task to run on one of the threads
+  void post(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    condition_.notify_one();
+  }
+
+private:
+  void run()
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() {return stopping_ || !tasks_.empty();});
+        if (stopping_) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+/// \brief Keep the calling thread busy for a while, standing in for the work of a request
+inline void busy_wait(std::chrono::microseconds duration)
+{
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+}  // namespace demo_nodes_cpp
+
+#endif  // DEMO_NODES_CPP__WORKER_POOL_HPP_
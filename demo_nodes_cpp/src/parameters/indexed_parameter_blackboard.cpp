@@ -0,0 +1,185 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rcl_interfaces/srv/describe_parameters.hpp"
+#include "rcl_interfaces/srv/get_parameter_types.hpp"
+#include "rcl_interfaces/srv/get_parameters.hpp"
+#include "rcl_interfaces/srv/list_parameters.hpp"
+#include "rcl_interfaces/srv/set_parameters.hpp"
+#include "rcl_interfaces/srv/set_parameters_atomically.hpp"
+#include "rclcpp/parameter_service_names.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "demo_nodes_cpp/indexed_parameter_store.hpp"
+#include "demo_nodes_cpp/parameter_event_coalescer.hpp"
+#include "demo_nodes_cpp/visibility_control.h"
+
+namespace demo_nodes_cpp
+{
+
+// A parameter blackboard for tens of thousands of parameters. Like parameter_blackboard, it
+// takes the parameters it is started with, and any other node may add, change and delete
+// parameters. But instead of the node's own parameters, it serves the parameter services from
+// an IndexedParameterStore: listing a prefix only visits the parameters under it, and the
+// services are in a reentrant callback group, so with a multi-threaded executor reads go on in
+// parallel, each of them seeing the parameters as they were between two sets.
+// Only the parameters the blackboard holds go through the services; the node's own, like
+// use_sim_time, stay out of them.
+// With event_window_ms set, the changes over each window go out as one parameter event, rather
+// than one event per set call, so that loading thousands of parameters one by one doesn't flood
+// every subscriber of /parameter_events.
+class IndexedParameterBlackboard : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit IndexedParameterBlackboard(rclcpp::NodeOptions options)
+  : Node(
+      "parameter_blackboard",
+      options.start_parameter_services(false).start_parameter_event_publisher(false))
+  {
+    const int64_t event_window_ms = this->declare_parameter("event_window_ms", 0);
+
+    std::vector<rcl_interfaces::msg::Parameter> overrides;
+    for (const auto & [name, value] :
+      this->get_node_parameters_interface()->get_parameter_overrides())
+    {
+      if (this->has_parameter(name)) {
+        continue;
+      }
+      rcl_interfaces::msg::Parameter parameter;
+      parameter.name = name;
+      parameter.value = value.to_value_msg();
+      overrides.push_back(std::move(parameter));
+    }
+    store_.declare(std::move(overrides));
+
+    events_pub_ = this->create_publisher<rcl_interfaces::msg::ParameterEvent>(
+      "/parameter_events", rclcpp::ParameterEventsQoS());
+    if (event_window_ms > 0) {
+      events_timer_ = this->create_wall_timer(
+        std::chrono::milliseconds(event_window_ms), [this]() {
+          for (auto & event : pending_events_.take()) {
+            events_pub_->publish(std::move(event));
+          }
+        });
+    }
+    create_services();
+
+    RCLCPP_INFO(
+      this->get_logger(),
+      "Indexed parameter blackboard node named '%s' ready, and serving '%zu' parameters already!",
+      this->get_fully_qualified_name(), store_.size());
+  }
+
+private:
+  void create_services()
+  {
+    namespace names = rclcpp::parameter_service_names;
+    using rcl_interfaces::srv::DescribeParameters;
+    using rcl_interfaces::srv::GetParameterTypes;
+    using rcl_interfaces::srv::GetParameters;
+    using rcl_interfaces::srv::ListParameters;
+    using rcl_interfaces::srv::SetParameters;
+    using rcl_interfaces::srv::SetParametersAtomically;
+
+    auto group = this->create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+    const std::string prefix = std::string(this->get_fully_qualified_name()) + "/";
+    const rclcpp::QoS qos = rclcpp::ParametersQoS();
+
+    get_srv_ = this->create_service<GetParameters>(
+      prefix + names::get_parameters,
+      [this](
+        const std::shared_ptr<GetParameters::Request> request,
+        std::shared_ptr<GetParameters::Response> response) {
+        response->values = store_.get(request->names);
+      }, qos, group);
+    get_types_srv_ = this->create_service<GetParameterTypes>(
+      prefix + names::get_parameter_types,
+      [this](
+        const std::shared_ptr<GetParameterTypes::Request> request,
+        std::shared_ptr<GetParameterTypes::Response> response) {
+        response->types = store_.get_types(request->names);
+      }, qos, group);
+    set_srv_ = this->create_service<SetParameters>(
+      prefix + names::set_parameters,
+      [this](
+        const std::shared_ptr<SetParameters::Request> request,
+        std::shared_ptr<SetParameters::Response> response) {
+        response->results = store_.set(
+          request->parameters, [this](rcl_interfaces::msg::ParameterEvent & event) {
+            publish(event);
+          });
+      }, qos, group);
+    set_atomically_srv_ = this->create_service<SetParametersAtomically>(
+      prefix + names::set_parameters_atomically,
+      [this](
+        const std::shared_ptr<SetParametersAtomically::Request> request,
+        std::shared_ptr<SetParametersAtomically::Response> response) {
+        response->result = store_.set_atomically(
+          request->parameters, [this](rcl_interfaces::msg::ParameterEvent & event) {
+            publish(event);
+          });
+      }, qos, group);
+    describe_srv_ = this->create_service<DescribeParameters>(
+      prefix + names::describe_parameters,
+      [this](
+        const std::shared_ptr<DescribeParameters::Request> request,
+        std::shared_ptr<DescribeParameters::Response> response) {
+        response->descriptors = store_.describe(request->names);
+      }, qos, group);
+    list_srv_ = this->create_service<ListParameters>(
+      prefix + names::list_parameters,
+      [this](
+        const std::shared_ptr<ListParameters::Request> request,
+        std::shared_ptr<ListParameters::Response> response) {
+        response->result = store_.list(request->prefixes, request->depth);
+      }, qos, group);
+  }
+
+  // Called by the store while it holds its write lock, so that events of concurrent set requests
+  // are published, or coalesced, in the order their changes were made.
+  void publish(rcl_interfaces::msg::ParameterEvent & event)
+  {
+    event.node = this->get_fully_qualified_name();
+    event.stamp = this->now();
+    if (events_timer_) {
+      pending_events_.add(event);
+    } else {
+      events_pub_->publish(std::move(event));
+    }
+  }
+
+  IndexedParameterStore store_;
+  ParameterEventCoalescer pending_events_;
+  rclcpp::Publisher<rcl_interfaces::msg::ParameterEvent>::SharedPtr events_pub_;
+  rclcpp::TimerBase::SharedPtr events_timer_;
+  rclcpp::Service<rcl_interfaces::srv::GetParameters>::SharedPtr get_srv_;
+  rclcpp::Service<rcl_interfaces::srv::GetParameterTypes>::SharedPtr get_types_srv_;
+  rclcpp::Service<rcl_interfaces::srv::SetParameters>::SharedPtr set_srv_;
+  rclcpp::Service<rcl_interfaces::srv::SetParametersAtomically>::SharedPtr set_atomically_srv_;
+  rclcpp::Service<rcl_interfaces::srv::DescribeParameters>::SharedPtr describe_srv_;
+  rclcpp::Service<rcl_interfaces::srv::ListParameters>::SharedPtr list_srv_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::IndexedParameterBlackboard)
@@ -0,0 +1,233 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "demo_nodes_cpp/batched_parameters_client.hpp"
+
+using namespace std::chrono_literals;
+
+// Compares getting, setting and describing every parameter of a blackboard node, which holds
+// thousands of them like parameter_blackboard, one parameter per request with a
+// SyncParametersClient, as set_and_get_parameters does, against BatchedParametersClient with
+// several batch sizes.
+
+struct Options
+{
+  size_t parameters = 10000;
+  size_t per_call = 10000;
+  std::vector<size_t> batch_sizes{10, 100, 1000, 10000};
+  size_t in_flight = 4;
+};
+
+constexpr char kBlackboard[] = "parameter_batch_benchmark_blackboard";
+
+std::string parameter_name(size_t i)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "p%06zu", i);
+  return name;
+}
+
+void print_line(
+  const char * operation, const char * client, size_t batch, size_t in_flight, size_t requests,
+  size_t parameters, std::chrono::steady_clock::duration elapsed)
+{
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  printf(
+    "%-9s  %-8s  %6zu  %9zu  %8zu  %10.1f  %10.0f\n", operation, client, batch, in_flight,
+    requests, seconds * 1e3, parameters / seconds);
+}
+
+// One parameter per request, waiting for each response before sending the next request.
+void run_per_call(const Options & options, const std::vector<std::string> & names)
+{
+  auto node = std::make_shared<rclcpp::Node>("parameter_batch_benchmark_sync_client");
+  auto client = std::make_shared<rclcpp::SyncParametersClient>(node, kBlackboard);
+  if (!client->wait_for_service(5s)) {
+    printf("The blackboard's services didn't come up\n");
+    return;
+  }
+  size_t count = std::min(options.per_call, names.size());
+  auto time = [count](const char * operation, const std::function<void(size_t)> & call) {
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < count; ++i) {
+        call(i);
+      }
+      print_line(
+        operation, "per-call", 1, 1, count, count, std::chrono::steady_clock::now() - start);
+    };
+  time(
+    "get", [&](size_t i) {
+      if (client->get_parameters({names[i]}).size() != 1) {
+        throw std::runtime_error("get_parameters failed");
+      }
+    });
+  time(
+    "set", [&](size_t i) {
+      auto results = client->set_parameters({rclcpp::Parameter(names[i], static_cast<int>(i))});
+      if (results.size() != 1 || !results.front().successful) {
+        throw std::runtime_error("set_parameters failed");
+      }
+    });
+  time(
+    "describe", [&](size_t i) {
+      if (client->describe_parameters({names[i]}).size() != 1) {
+        throw std::runtime_error("describe_parameters failed");
+      }
+    });
+}
+
+// Every parameter in one call, split into requests of the given size.
+void run_batched(const Options & options, const std::vector<std::string> & names, size_t batch)
+{
+  auto node = std::make_shared<rclcpp::Node>("parameter_batch_benchmark_batched_client");
+  demo_nodes_cpp::BatchedParametersClient client(node, kBlackboard, batch, options.in_flight);
+  if (!client.wait_for_service(5s)) {
+    printf("The blackboard's services didn't come up\n");
+    return;
+  }
+  size_t requests = (names.size() + batch - 1) / batch;
+  auto time = [&](const char * operation, auto future) {
+      auto start = std::chrono::steady_clock::now();
+      if (rclcpp::spin_until_future_complete(node, future) != rclcpp::FutureReturnCode::SUCCESS) {
+        throw std::runtime_error(std::string(operation) + " was interrupted");
+      }
+      if (future.get().size() != names.size()) {
+        throw std::runtime_error(std::string(operation) + " failed");
+      }
+      print_line(
+        operation, "batched", batch, options.in_flight, requests, names.size(),
+        std::chrono::steady_clock::now() - start);
+      return future.get();
+    };
+  time("get", client.get_parameters(names));
+  std::vector<rclcpp::Parameter> parameters;
+  parameters.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    parameters.emplace_back(names[i], static_cast<int>(i + batch));
+  }
+  for (const auto & result : time("set", client.set_parameters(std::move(parameters)))) {
+    if (!result.successful) {
+      throw std::runtime_error("set_parameters failed: " + result.reason);
+    }
+  }
+  time("describe", client.describe_parameters(names));
+}
+
+std::vector<size_t> parse_list(const char * value)
+{
+  std::vector<size_t> list;
+  std::stringstream stream(value ? value : "");
+  for (std::string item; std::getline(stream, item, ','); ) {
+    list.push_back(std::stoul(item));
+  }
+  return list;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --parameters N    Parameters on the blackboard. Defaults to 10000.\n");
+  printf("  --per-call N      Parameters to go through one by one. Defaults to 10000.\n");
+  printf("  --batches LIST    Comma separated batch sizes. Defaults to 10,100,1000,10000.\n");
+  printf("  --in-flight N     Batches in flight at a time. Defaults to 4.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--parameters")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--parameters");
+      options.parameters = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--per-call")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--per-call");
+      options.per_call = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--batches")) {
+      options.batch_sizes = parse_list(rcutils_cli_get_option(argv, end, "--batches"));
+    }
+    if (rcutils_cli_option_exist(argv, end, "--in-flight")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--in-flight");
+      options.in_flight = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  bool valid = options.parameters > 0 && options.in_flight > 0;
+  for (size_t batch : options.batch_sizes) {
+    valid = valid && batch > 0;
+  }
+  if (!valid) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  std::vector<std::string> names;
+  names.reserve(options.parameters);
+  auto blackboard = std::make_shared<rclcpp::Node>(
+    kBlackboard, rclcpp::NodeOptions().allow_undeclared_parameters(true));
+  for (size_t i = 0; i < options.parameters; ++i) {
+    names.push_back(parameter_name(i));
+    blackboard->declare_parameter(names.back(), 0);
+  }
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(blackboard);
+  std::thread blackboard_thread([&executor]() {executor.spin();});
+
+  printf("operation  client     batch  in flight  requests    total ms    params/s\n");
+  try {
+    if (options.per_call > 0) {
+      run_per_call(options, names);
+    }
+    for (size_t batch : options.batch_sizes) {
+      if (!rclcpp::ok()) {
+        break;
+      }
+      run_batched(options, names, batch);
+    }
+  } catch (const std::exception & e) {
+    printf("%s\n", e.what());
+  }
+
+  executor.cancel();
+  blackboard_thread.join();
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,312 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rcl_interfaces/msg/list_parameters_result.hpp"
+#include "rcl_interfaces/srv/list_parameters.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "demo_nodes_cpp/indexed_parameter_store.hpp"
+
+// Compares the parameters of a node, as parameter_blackboard holds them, with the
+// IndexedParameterStore of indexed_parameter_blackboard, for a blackboard of many parameters
+// named "g<i>.s<j>.p<k>", 1000 to a group and 100 to a subgroup:
+// - how long it takes to start with all of them as overrides;
+// - how long listing all of them, listing a group, listing a subgroup and getting 100 of them
+//   take;
+// - how many of those reads a second threads manage together while another thread sets
+//   parameters.
+// The calls are made directly, without the services in between, which cost the same for both.
+// Before that, it checks that both list the same parameters at depths 1 to 3.
+
+using rcl_interfaces::srv::ListParameters;
+
+struct Options
+{
+  size_t parameters = 20000;
+  size_t repeat = 100;
+  size_t threads = 4;
+  double duration = 1.0;
+};
+
+std::string parameter_name(size_t i)
+{
+  return "g" + std::to_string(i / 1000) + ".s" + std::to_string(i / 100 % 10) + ".p" +
+         std::to_string(i);
+}
+
+// The blackboard as a node, which allows undeclared parameters and declares its overrides.
+class NodeBlackboard
+{
+public:
+  static constexpr const char * kName = "node";
+
+  explicit NodeBlackboard(const std::vector<std::string> & names)
+  {
+    std::vector<rclcpp::Parameter> overrides;
+    overrides.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      overrides.emplace_back(names[i], static_cast<int64_t>(i));
+    }
+    node_ = std::make_shared<rclcpp::Node>(
+      "parameter_blackboard_benchmark",
+      rclcpp::NodeOptions().allow_undeclared_parameters(true).
+      automatically_declare_parameters_from_overrides(true).
+      parameter_overrides(std::move(overrides)).
+      start_parameter_services(false));
+  }
+
+  rcl_interfaces::msg::ListParametersResult list(
+    const std::vector<std::string> & prefixes, uint64_t depth)
+  {
+    return node_->list_parameters(prefixes, depth);
+  }
+
+  size_t get(const std::vector<std::string> & names)
+  {
+    return node_->get_parameters(names).size();
+  }
+
+  void set(const std::string & name, int64_t value)
+  {
+    node_->set_parameters({rclcpp::Parameter(name, value)});
+  }
+
+private:
+  rclcpp::Node::SharedPtr node_;
+};
+
+// The blackboard as an IndexedParameterStore.
+class IndexedBlackboard
+{
+public:
+  static constexpr const char * kName = "indexed";
+
+  explicit IndexedBlackboard(const std::vector<std::string> & names)
+  {
+    std::vector<rcl_interfaces::msg::Parameter> parameters(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      parameters[i].name = names[i];
+      parameters[i].value = rclcpp::ParameterValue(static_cast<int64_t>(i)).to_value_msg();
+    }
+    store_.declare(std::move(parameters));
+  }
+
+  rcl_interfaces::msg::ListParametersResult list(
+    const std::vector<std::string> & prefixes, uint64_t depth)
+  {
+    return store_.list(prefixes, depth);
+  }
+
+  size_t get(const std::vector<std::string> & names)
+  {
+    return store_.get(names).size();
+  }
+
+  void set(const std::string & name, int64_t value)
+  {
+    rcl_interfaces::msg::Parameter parameter;
+    parameter.name = name;
+    parameter.value = rclcpp::ParameterValue(value).to_value_msg();
+    store_.set({parameter});
+  }
+
+private:
+  demo_nodes_cpp::IndexedParameterStore store_;
+};
+
+double microseconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+// Throws if the two blackboards list different parameters for a prefix and a depth.
+void compare_listings(const std::vector<std::string> & names)
+{
+  NodeBlackboard node(names);
+  IndexedBlackboard indexed(names);
+  auto sorted = [](std::vector<std::string> list) {
+      std::sort(list.begin(), list.end());
+      return list;
+    };
+  for (const std::vector<std::string> & prefixes :
+    std::vector<std::vector<std::string>>{{}, {"g1"}, {"g1.s2"}, {"g1", "g1.s2"}})
+  {
+    for (uint64_t depth : {1, 2, 3}) {
+      auto expected = node.list(prefixes, depth);
+      auto result = indexed.list(prefixes, depth);
+      if (sorted(expected.names) != sorted(result.names) ||
+        sorted(expected.prefixes) != sorted(result.prefixes))
+      {
+        std::string listed = prefixes.empty() ? "all" : prefixes.front();
+        if (prefixes.size() > 1) {
+          listed += ",...";
+        }
+        std::string message = "listing " + listed + " at depth " + std::to_string(depth);
+        message += " differs: " + std::to_string(result.names.size()) + " parameters instead of ";
+        throw std::runtime_error(message + std::to_string(expected.names.size()));
+      }
+    }
+  }
+}
+
+template<typename Blackboard>
+void run(const Options & options, const std::vector<std::string> & names)
+{
+  auto start = std::chrono::steady_clock::now();
+  Blackboard blackboard(names);
+  double startup_ms = microseconds_since(start) / 1e3;
+
+  std::vector<std::string> some;
+  for (size_t i = 0; i < 100; ++i) {
+    some.push_back(names[i * 7919 % names.size()]);
+  }
+  const uint64_t recursive = ListParameters::Request::DEPTH_RECURSIVE;
+  auto time = [&options](const std::function<size_t()> & query) {
+      auto start = std::chrono::steady_clock::now();
+      size_t results = 0;
+      for (size_t i = 0; i < options.repeat; ++i) {
+        results += query();
+      }
+      if (results == 0) {
+        throw std::runtime_error("a query found nothing");
+      }
+      return microseconds_since(start) / options.repeat;
+    };
+  double list_all_us = time([&]() {return blackboard.list({}, recursive).names.size();});
+  double list_group_us = time([&]() {return blackboard.list({"g1"}, recursive).names.size();});
+  double list_subgroup_us = time(
+    [&]() {return blackboard.list({"g1.s2"}, recursive).names.size();});
+  double get_us = time([&]() {return blackboard.get(some);});
+
+  // Readers list subgroups and get parameters while a writer keeps setting parameters.
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> reads{0};
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < options.threads; ++t) {
+    readers.emplace_back(
+      [&, t]() {
+        uint64_t done = 0;
+        for (size_t i = t; running; ++i) {
+          if (i % 2) {
+            blackboard.list({"g0.s" + std::to_string(i % 10)}, recursive);
+          } else {
+            blackboard.get(some);
+          }
+          ++done;
+        }
+        reads += done;
+      });
+  }
+  std::thread writer(
+    [&]() {
+      for (size_t i = 0; running; ++i) {
+        blackboard.set(names[i % names.size()], static_cast<int64_t>(i));
+      }
+    });
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+  running = false;
+  writer.join();
+  for (auto & reader : readers) {
+    reader.join();
+  }
+
+  printf(
+    "%-8s  %10.1f  %10.1f  %10.1f  %10.1f  %10.1f  %10.0f\n", Blackboard::kName, startup_ms,
+    list_all_us, list_group_us, list_subgroup_us, get_us, reads / options.duration);
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --parameters N    Parameters on the blackboard. Defaults to 20000.\n");
+  printf("  --repeat N        Times to run each query. Defaults to 100.\n");
+  printf("  --threads N       Threads reading while one sets. Defaults to 4.\n");
+  printf("  --duration S      Seconds to read and set for. Defaults to 1.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--parameters")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--parameters");
+      options.parameters = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--repeat")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--repeat");
+      options.repeat = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--threads")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--threads");
+      options.threads = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      options.duration = std::stod(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  // The queries look at group g1, so there have to be at least two groups.
+  if (options.parameters < 2000 || options.repeat == 0 || options.duration <= 0.0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  std::vector<std::string> names;
+  names.reserve(options.parameters);
+  for (size_t i = 0; i < options.parameters; ++i) {
+    names.push_back(parameter_name(i));
+  }
+
+  printf(
+    "%zu parameters, times in us unless noted, reads/s with %zu threads reading\n",
+    options.parameters, options.threads);
+  printf("store     startup ms    list all  list group   list sub.     get 100     reads/s\n");
+  try {
+    compare_listings(names);
+    run<NodeBlackboard>(options, names);
+    run<IndexedBlackboard>(options, names);
+  } catch (const std::exception & e) {
+    printf("%s\n", e.what());
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,318 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rcl_interfaces/msg/parameter_event.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "demo_nodes_cpp/indexed_parameter_event_handler.hpp"
+#include "demo_nodes_cpp/parameter_event_coalescer.hpp"
+
+// Measures what dispatching a parameter event to the parameter callbacks costs, depending on
+// how many callbacks there are, for rclcpp::ParameterEventHandler and
+// IndexedParameterEventHandler. The callbacks watch parameters "p<i>" spread over 10 nodes,
+// and each event changes parameters of one of those nodes, half of which have a callback.
+// The events are handed to the handlers directly, without going through the middleware.
+// Then, for a bulk load of as many single parameter events, how long it takes to dispatch them
+// one by one, and to coalesce them into one event with ParameterEventCoalescer and dispatch
+// that.
+// Last, for a monitor of the parameters matching "*_param" of the nodes matching "/group0/*",
+// among hundreds of nodes, what filtering the events costs with regular expressions, built for
+// every event as parameter_event_handler's cb3 used to or built once, and with a filtered
+// callback of IndexedParameterEventHandler.
+
+constexpr size_t kNodes = 10;
+
+struct Options
+{
+  std::vector<size_t> callback_counts{1, 10, 100, 1000, 10000};
+  size_t parameters = 10;
+  size_t events = 10000;
+  size_t monitored_nodes = 300;
+};
+
+std::string node_name(size_t i)
+{
+  return "/node" + std::to_string(i % kNodes);
+}
+
+rcl_interfaces::msg::Parameter parameter_msg(size_t i, int64_t value)
+{
+  rcl_interfaces::msg::Parameter parameter;
+  parameter.name = "p" + std::to_string(i);
+  parameter.value = rclcpp::ParameterValue(value).to_value_msg();
+  return parameter;
+}
+
+// Events changing different parameters of one node each, up to half of which have a
+// callback.
+std::vector<rcl_interfaces::msg::ParameterEvent> make_events(
+  const Options & options, size_t callbacks)
+{
+  const size_t range = std::max(callbacks * 2 / kNodes, options.parameters);
+  uint64_t random = 1;
+  std::vector<rcl_interfaces::msg::ParameterEvent> events(options.events);
+  for (size_t i = 0; i < events.size(); ++i) {
+    events[i].node = node_name(i);
+    random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+    const size_t first = (random >> 33) % range;
+    for (size_t j = 0; j < options.parameters; ++j) {
+      size_t parameter = (first + j) % range * kNodes + i % kNodes;
+      events[i].changed_parameters.push_back(
+        parameter_msg(parameter, static_cast<int64_t>(j)));
+    }
+  }
+  return events;
+}
+
+double microseconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename HandlerT>
+void run(
+  const char * name, rclcpp::Node::SharedPtr node, size_t callbacks,
+  const std::vector<rcl_interfaces::msg::ParameterEvent> & events)
+{
+  auto handler = std::make_shared<HandlerT>(node);
+  uint64_t called = 0;
+  std::vector<std::shared_ptr<void>> handles;
+  for (size_t i = 0; i < callbacks; ++i) {
+    handles.push_back(
+      handler->add_parameter_callback(
+        "p" + std::to_string(i), [&called](const rclcpp::Parameter &) {++called;},
+        node_name(i)));
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (const auto & event : events) {
+    handler->event_callback(event);
+  }
+  double elapsed_us = microseconds_since(start);
+  printf(
+    "%-8s  %9zu  %12.2f  %14.1f\n", name, callbacks, elapsed_us / events.size(),
+    static_cast<double>(called) / events.size());
+}
+
+void run_bulk_load(const Options & options, rclcpp::Node::SharedPtr node)
+{
+  std::vector<rcl_interfaces::msg::ParameterEvent> events(options.events);
+  for (size_t i = 0; i < events.size(); ++i) {
+    events[i].node = node_name(0);
+    events[i].new_parameters.push_back(parameter_msg(i * kNodes, static_cast<int64_t>(i)));
+  }
+  demo_nodes_cpp::IndexedParameterEventHandler handler(node);
+  uint64_t called = 0;
+  std::vector<std::shared_ptr<void>> handles;
+  for (size_t i = 0; i < events.size(); ++i) {
+    handles.push_back(
+      handler.add_parameter_callback(
+        "p" + std::to_string(i * kNodes), [&called](const rclcpp::Parameter &) {++called;},
+        node_name(0)));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto & event : events) {
+    handler.event_callback(event);
+  }
+  printf(
+    "one by one  %6zu events  %10.1f us  %6" PRIu64 " calls\n", events.size(),
+    microseconds_since(start), called);
+
+  called = 0;
+  start = std::chrono::steady_clock::now();
+  demo_nodes_cpp::ParameterEventCoalescer coalescer;
+  for (const auto & event : events) {
+    coalescer.add(event);
+  }
+  auto coalesced = coalescer.take();
+  for (const auto & event : coalesced) {
+    handler.event_callback(event);
+  }
+  printf(
+    "coalesced   %6zu events  %10.1f us  %6" PRIu64 " calls\n", coalesced.size(),
+    microseconds_since(start), called);
+}
+
+// Events of the monitored nodes, a tenth of which are in /group0, half of their parameters
+// ending in "_param".
+std::vector<rcl_interfaces::msg::ParameterEvent> make_monitored_events(const Options & options)
+{
+  std::vector<rcl_interfaces::msg::ParameterEvent> events(options.events);
+  for (size_t i = 0; i < events.size(); ++i) {
+    size_t node = i % options.monitored_nodes;
+    events[i].node = "/group" + std::to_string(node % 10) + "/node" + std::to_string(node);
+    for (size_t j = 0; j < options.parameters; ++j) {
+      auto parameter = parameter_msg(j, static_cast<int64_t>(i));
+      if (j % 2) {
+        parameter.name += "_param";
+      }
+      events[i].changed_parameters.push_back(std::move(parameter));
+    }
+  }
+  return events;
+}
+
+template<typename HandlerT>
+void run_monitor(
+  const char * name, const std::vector<rcl_interfaces::msg::ParameterEvent> & events,
+  const std::function<void(HandlerT &, uint64_t &)> & monitor, rclcpp::Node::SharedPtr node)
+{
+  HandlerT handler(node);
+  uint64_t called = 0;
+  monitor(handler, called);
+  auto start = std::chrono::steady_clock::now();
+  for (const auto & event : events) {
+    handler.event_callback(event);
+  }
+  double elapsed_us = microseconds_since(start);
+  printf(
+    "%-10s  %12.2f  %14.2f\n", name, elapsed_us / events.size(),
+    static_cast<double>(called) / events.size());
+}
+
+void run_monitors(const Options & options, rclcpp::Node::SharedPtr node)
+{
+  auto events = make_monitored_events(options);
+  std::shared_ptr<void> handle;
+  auto matches = [](
+    const rcl_interfaces::msg::ParameterEvent & event, const std::regex & node_re,
+    const std::regex & parameter_re, uint64_t & called) {
+      if (std::regex_match(event.node, node_re)) {
+        for (const auto & parameter :
+          rclcpp::ParameterEventHandler::get_parameters_from_event(event))
+        {
+          if (std::regex_match(parameter.get_name(), parameter_re)) {
+            ++called;
+          }
+        }
+      }
+    };
+  run_monitor<rclcpp::ParameterEventHandler>(
+    "regex", events, [&](rclcpp::ParameterEventHandler & handler, uint64_t & called) {
+      handle = handler.add_parameter_event_callback(
+        [&matches, &called](const rcl_interfaces::msg::ParameterEvent & event) {
+          std::regex node_re("/group0/.*");
+          std::regex parameter_re(".*_param");
+          matches(event, node_re, parameter_re, called);
+        });
+    }, node);
+  const std::regex node_re("/group0/.*");
+  const std::regex parameter_re(".*_param");
+  run_monitor<rclcpp::ParameterEventHandler>(
+    "regex once", events, [&](rclcpp::ParameterEventHandler & handler, uint64_t & called) {
+      handle = handler.add_parameter_event_callback(
+        [&](const rcl_interfaces::msg::ParameterEvent & event) {
+          matches(event, node_re, parameter_re, called);
+        });
+    }, node);
+  run_monitor<demo_nodes_cpp::IndexedParameterEventHandler>(
+    "glob", events, [&](demo_nodes_cpp::IndexedParameterEventHandler & handler, uint64_t & called) {
+      handle = handler.add_filtered_parameter_callback(
+        "*_param", [&called](const std::string &, const rclcpp::Parameter &) {++called;},
+        "/group0/*");
+    }, node);
+}
+
+std::vector<size_t> parse_list(const char * value)
+{
+  std::vector<size_t> list;
+  std::stringstream stream(value ? value : "");
+  for (std::string item; std::getline(stream, item, ','); ) {
+    list.push_back(std::stoul(item));
+  }
+  return list;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --callbacks LIST  Comma separated callback counts. Defaults to 1,10,100,1000,10000.\n");
+  printf("  --parameters N    Parameters changed per event. Defaults to 10.\n");
+  printf("  --events N        Events to dispatch. Defaults to 10000.\n");
+  printf("  --nodes N         Nodes with parameters to monitor. Defaults to 300.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--callbacks")) {
+      options.callback_counts = parse_list(rcutils_cli_get_option(argv, end, "--callbacks"));
+    }
+    if (rcutils_cli_option_exist(argv, end, "--parameters")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--parameters");
+      options.parameters = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--events")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--events");
+      options.events = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--nodes")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--nodes");
+      options.monitored_nodes = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (options.events == 0 || options.monitored_nodes == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<rclcpp::Node>("parameter_event_dispatch_benchmark");
+
+  printf(
+    "%zu events of %zu parameters, dispatch time per event\n", options.events,
+    options.parameters);
+  printf("handler   callbacks  us per event  calls per event\n");
+  for (size_t callbacks : options.callback_counts) {
+    auto events = make_events(options, callbacks);
+    run<rclcpp::ParameterEventHandler>("rclcpp", node, callbacks, events);
+    run<demo_nodes_cpp::IndexedParameterEventHandler>("indexed", node, callbacks, events);
+  }
+  printf("\nbulk load of %zu parameters of one node, each with a callback\n", options.events);
+  run_bulk_load(options, node);
+  printf(
+    "\nmonitor of parameters \"*_param\" of nodes \"/group0/*\", among %zu nodes\n",
+    options.monitored_nodes);
+  printf("filter      us per event  calls per event\n");
+  run_monitors(options, node);
+
+  rclcpp::shutdown();
+
+  return 0;
+}
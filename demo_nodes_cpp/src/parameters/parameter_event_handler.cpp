@@ -105,12 +105,13 @@ int main(int argc, char ** argv)
   auto handle2 = param_subscriber->add_parameter_callback(
     remote_param_name, cb2, fqn);
 
-  // We can also monitor all parameter changes and do our own filtering/searching
+  // We can also monitor all parameter changes and do our own filtering/searching.
+  // Use a regular expression to scan for any updates to parameters in "/a_namespace"
+  // as well as any parameter changes to our own node. Compiling it is costly, so it is
+  // compiled once here rather than for every event.
+  const std::regex re("(/a_namespace/.*)|(/this_node)");
   auto cb3 =
-    [fqn, remote_param_name, &node](const rcl_interfaces::msg::ParameterEvent & event) {
-      // Use a regular expression to scan for any updates to parameters in "/a_namespace"
-      // as well as any parameter changes to our own node
-      std::regex re("(/a_namespace/.*)|(/this_node)");
+    [fqn, remote_param_name, re, &node](const rcl_interfaces::msg::ParameterEvent & event) {
       if (regex_match(event.node, re)) {
         // You can use 'get_parameter_from_event' if you know the node name and parameter name
         // that you're looking for
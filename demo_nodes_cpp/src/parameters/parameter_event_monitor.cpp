@@ -0,0 +1,68 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "demo_nodes_cpp/indexed_parameter_event_handler.hpp"
+#include "demo_nodes_cpp/visibility_control.h"
+
+namespace demo_nodes_cpp
+{
+
+// Logs the changes to the parameters matching the glob patterns in "parameters", of the nodes
+// matching those in "nodes", e.g. nodes:=['/a_namespace/*'] parameters:=['*_param'].
+// The patterns are compiled once, when the node starts, and events of other nodes are dropped
+// after a lookup of their node's name, so that it can watch a few of hundreds of nodes.
+class ParameterEventMonitor : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit ParameterEventMonitor(const rclcpp::NodeOptions & options)
+  : Node("parameter_event_monitor", options)
+  {
+    auto nodes = this->declare_parameter("nodes", std::vector<std::string>{"*"});
+    auto parameters = this->declare_parameter("parameters", std::vector<std::string>{"*"});
+
+    handler_ = std::make_shared<IndexedParameterEventHandler>(this);
+    auto callback = [this](const std::string & node_name, const rclcpp::Parameter & parameter) {
+        RCLCPP_INFO(
+          this->get_logger(), "%s: \"%s\" of type %s is now \"%s\"", node_name.c_str(),
+          parameter.get_name().c_str(), parameter.get_type_name().c_str(),
+          parameter.value_to_string().c_str());
+      };
+    for (const auto & node_pattern : nodes) {
+      for (const auto & parameter_pattern : parameters) {
+        handles_.push_back(
+          handler_->add_filtered_parameter_callback(parameter_pattern, callback, node_pattern));
+        RCLCPP_INFO(
+          this->get_logger(), "Monitoring parameters \"%s\" of nodes \"%s\"",
+          parameter_pattern.c_str(), node_pattern.c_str());
+      }
+    }
+  }
+
+private:
+  std::shared_ptr<IndexedParameterEventHandler> handler_;
+  std::vector<std::shared_ptr<IndexedParameterEventHandler::FilteredParameterCallbackHandle>>
+  handles_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::ParameterEventMonitor)
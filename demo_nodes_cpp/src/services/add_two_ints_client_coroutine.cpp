@@ -0,0 +1,70 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "example_interfaces/srv/add_two_ints.hpp"
+
+#include "demo_nodes_cpp/coroutine_client.hpp"
+#include "demo_nodes_cpp/visibility_control.h"
+
+using namespace std::chrono_literals;
+
+namespace demo_nodes_cpp
+{
+// The same as add_two_ints_client_async, written as a coroutine: it reads top to bottom like the
+// synchronous client, but neither waiting for the service nor for the response blocks the
+// executor.
+class CoroutineClientNode : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit CoroutineClientNode(const rclcpp::NodeOptions & options)
+  : Node("add_two_ints_client", options)
+  {
+    setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+    client_ = create_client<example_interfaces::srv::AddTwoInts>("add_two_ints");
+    call();
+  }
+
+private:
+  // Runs until its first co_await here, and on the executor after that.
+  Task call()
+  {
+    while (!client_->service_is_ready()) {
+      co_await sleep_for(*this, 1s);
+      if (!client_->service_is_ready()) {
+        RCLCPP_INFO(this->get_logger(), "service not available, waiting again...");
+      }
+    }
+    auto request = std::make_shared<example_interfaces::srv::AddTwoInts::Request>();
+    request->a = 2;
+    request->b = 3;
+
+    auto result = co_await async_call(client_, request);
+    RCLCPP_INFO(this->get_logger(), "Result of add_two_ints: %" PRId64, result->sum);
+    rclcpp::shutdown();
+  }
+
+  rclcpp::Client<example_interfaces::srv::AddTwoInts>::SharedPtr client_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::CoroutineClientNode)
@@ -0,0 +1,168 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "example_interfaces/srv/add_two_ints.hpp"
+
+#include "demo_nodes_cpp/latency_histogram.hpp"
+#include "demo_nodes_cpp/visibility_control.h"
+
+using namespace std::chrono_literals;
+
+namespace demo_nodes_cpp
+{
+// A load generator for add_two_ints_server: it keeps a window of requests in flight, sending a
+// new one whenever a response arrives, and reports the throughput and the latency of the
+// requests. Request n asks for n + 1, so responses which arrive out of order, or with the wrong
+// sum, are detected.
+class PipelinedClientNode : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit PipelinedClientNode(const rclcpp::NodeOptions & options)
+  : Node("add_two_ints_client_pipelined", options)
+  {
+    setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+    // How many requests to keep in flight.
+    in_flight_limit_ = static_cast<uint64_t>(this->declare_parameter("in_flight", 8));
+    // How many requests to send in total, 0 to keep going.
+    requests_ = static_cast<uint64_t>(this->declare_parameter("requests", 10000));
+    if (in_flight_limit_ == 0) {
+      throw std::invalid_argument("in_flight must be at least 1");
+    }
+    client_ = create_client<example_interfaces::srv::AddTwoInts>("add_two_ints");
+    // Poll for the service instead of blocking in wait_for_service(), so the executor is free.
+    wait_timer_ = this->create_wall_timer(
+      100ms, [this]() {
+        if (!client_->service_is_ready()) {
+          RCLCPP_INFO_THROTTLE(
+            this->get_logger(), *this->get_clock(), 1000,
+            "service not available, waiting again...");
+          return;
+        }
+        wait_timer_->cancel();
+        start_ = std::chrono::steady_clock::now();
+        last_report_ = start_;
+        while (in_flight_ < in_flight_limit_ && !done_sending()) {
+          send_request();
+        }
+        report_timer_ = this->create_wall_timer(1s, [this]() {report();});
+      });
+  }
+
+private:
+  using ServiceResponseFuture =
+    rclcpp::Client<example_interfaces::srv::AddTwoInts>::SharedFuture;
+
+  bool done_sending() const
+  {
+    return requests_ > 0 && sent_ >= requests_;
+  }
+
+  void send_request()
+  {
+    auto request = std::make_shared<example_interfaces::srv::AddTwoInts::Request>();
+    uint64_t sequence = sent_++;
+    request->a = static_cast<int64_t>(sequence);
+    request->b = 1;
+    auto sent_at = std::chrono::steady_clock::now();
+    ++in_flight_;
+    client_->async_send_request(
+      request, [this, sequence, sent_at](ServiceResponseFuture future) {
+        on_response(sequence, sent_at, future.get()->sum);
+      });
+  }
+
+  void on_response(
+    uint64_t sequence, std::chrono::steady_clock::time_point sent_at, int64_t sum)
+  {
+    int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - sent_at).count();
+    interval_.record(latency);
+    total_.record(latency);
+    --in_flight_;
+    ++completed_;
+    if (sum != static_cast<int64_t>(sequence) + 1) {
+      ++wrong_;
+    }
+    // A response for an older request than one already answered came out of order.
+    if (completed_ > 1 && sequence < newest_response_) {
+      ++reordered_;
+    } else {
+      newest_response_ = sequence;
+    }
+    if (!done_sending()) {
+      send_request();
+    } else if (in_flight_ == 0) {
+      finish();
+    }
+  }
+
+  /// Log the throughput and latency over the last second.
+  void report()
+  {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_report_).count();
+    RCLCPP_INFO(
+      this->get_logger(),
+      "%.0f requests/s, latency p50 %.1f us, p99 %.1f us, max %.1f us, %" PRIu64 " in flight",
+      interval_.count() / seconds, interval_.percentile(0.5) / 1e3,
+      interval_.percentile(0.99) / 1e3, interval_.max() / 1e3, in_flight_);
+    interval_.reset();
+    last_report_ = now;
+  }
+
+  void finish()
+  {
+    report_timer_->cancel();
+    double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    RCLCPP_INFO(
+      this->get_logger(),
+      "%" PRIu64 " requests with %" PRIu64 " in flight: %.0f requests/s, latency p50 %.1f us, "
+      "p99 %.1f us, p99.9 %.1f us, max %.1f us, %" PRIu64 " reordered, %" PRIu64 " wrong",
+      completed_, in_flight_limit_, completed_ / seconds, total_.percentile(0.5) / 1e3,
+      total_.percentile(0.99) / 1e3, total_.percentile(0.999) / 1e3, total_.max() / 1e3,
+      reordered_, wrong_);
+    rclcpp::shutdown();
+  }
+
+  uint64_t in_flight_limit_ = 8;
+  uint64_t requests_ = 0;
+  uint64_t sent_ = 0;
+  uint64_t in_flight_ = 0;
+  uint64_t completed_ = 0;
+  uint64_t newest_response_ = 0;
+  uint64_t reordered_ = 0;
+  uint64_t wrong_ = 0;
+  LatencyHistogram interval_;
+  LatencyHistogram total_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_report_;
+  rclcpp::Client<example_interfaces::srv::AddTwoInts>::SharedPtr client_;
+  rclcpp::TimerBase::SharedPtr wait_timer_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::PipelinedClientNode)
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <chrono>
 #include <cinttypes>
 #include <memory>
@@ -22,6 +23,7 @@
 #include "example_interfaces/srv/add_two_ints.hpp"
 
 #include "demo_nodes_cpp/visibility_control.h"
+#include "demo_nodes_cpp/worker_pool.hpp"
 
 namespace demo_nodes_cpp
 {
@@ -29,25 +31,59 @@ namespace demo_nodes_cpp
 class ServerNode final : public rclcpp::Node
 {
 public:
+  using AddTwoInts = example_interfaces::srv::AddTwoInts;
+
   DEMO_NODES_CPP_PUBLIC
   explicit ServerNode(const rclcpp::NodeOptions & options)
   : Node("add_two_ints_server", options)
   {
-    auto handle_add_two_ints = [this](
-      const std::shared_ptr<rmw_request_id_t> request_header,
-      const std::shared_ptr<example_interfaces::srv::AddTwoInts::Request> request,
-      std::shared_ptr<example_interfaces::srv::AddTwoInts::Response> response) -> void
-      {
-        (void)request_header;
-        RCLCPP_INFO(
-          this->get_logger(), "Incoming request\na: %" PRId64 " b: %" PRId64,
-          request->a, request->b);
-        response->sum = request->a + request->b;
+    // Log every request. Turn this off when loading the server with many requests.
+    log_requests_ = this->declare_parameter("log_requests", true);
+    // Put the service in a reentrant callback group, so a multi-threaded executor, e.g. in
+    // component_container_mt, handles several requests at once.
+    bool reentrant = this->declare_parameter("reentrant", false);
+    // Keep a thread busy for this long per request, standing in for real work.
+    work_ = std::chrono::microseconds(this->declare_parameter("work_us", 0));
+    // Hand requests to this many worker threads which send the responses when they are done,
+    // instead of answering in the callback, so a slow request doesn't hold up an executor
+    // thread. 0 answers in the callback.
+    int64_t deferred_workers = this->declare_parameter("deferred_workers", 0);
 
-        saw_request_ = true;
-      };
-    // Create a service that will use the callback function to handle requests.
-    srv_ = create_service<example_interfaces::srv::AddTwoInts>("add_two_ints", handle_add_two_ints);
+    rclcpp::CallbackGroup::SharedPtr group;
+    if (reentrant) {
+      group = this->create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+    }
+    if (deferred_workers > 0) {
+      workers_ = std::make_unique<WorkerPool>(static_cast<size_t>(deferred_workers));
+      auto handle_add_two_ints_deferred = [this](
+        const std::shared_ptr<rclcpp::Service<AddTwoInts>> service,
+        const std::shared_ptr<rmw_request_id_t> request_header,
+        const std::shared_ptr<AddTwoInts::Request> request) -> void
+        {
+          log_request(*request);
+          workers_->post(
+            [this, service, request_header, request]() {
+              AddTwoInts::Response response;
+              handle(*request, response);
+              service->send_response(*request_header, response);
+            });
+        };
+      srv_ = create_service<AddTwoInts>(
+        "add_two_ints", handle_add_two_ints_deferred, rclcpp::ServicesQoS(), group);
+    } else {
+      auto handle_add_two_ints = [this](
+        const std::shared_ptr<rmw_request_id_t> request_header,
+        const std::shared_ptr<AddTwoInts::Request> request,
+        std::shared_ptr<AddTwoInts::Response> response) -> void
+        {
+          (void)request_header;
+          log_request(*request);
+          handle(*request, *response);
+        };
+      // Create a service that will use the callback function to handle requests.
+      srv_ = create_service<AddTwoInts>(
+        "add_two_ints", handle_add_two_ints, rclcpp::ServicesQoS(), group);
+    }
 
     bool one_shot = this->declare_parameter("one_shot", false);
     if (one_shot) {
@@ -62,9 +98,32 @@ public:
   }
 
 private:
-  rclcpp::Service<example_interfaces::srv::AddTwoInts>::SharedPtr srv_;
+  void log_request(const AddTwoInts::Request & request)
+  {
+    if (log_requests_) {
+      RCLCPP_INFO(
+        this->get_logger(), "Incoming request\na: %" PRId64 " b: %" PRId64,
+        request.a, request.b);
+    }
+  }
+
+  void handle(const AddTwoInts::Request & request, AddTwoInts::Response & response)
+  {
+    if (work_.count() > 0) {
+      busy_wait(work_);
+    }
+    response.sum = request.a + request.b;
+
+    saw_request_ = true;
+  }
+
+  rclcpp::Service<AddTwoInts>::SharedPtr srv_;
   rclcpp::TimerBase::SharedPtr timer_;
-  bool saw_request_{false};
+  std::atomic<bool> saw_request_{false};
+  bool log_requests_{true};
+  std::chrono::microseconds work_{0};
+  // Destroyed first, so no worker is still running a request when the rest goes away.
+  std::unique_ptr<WorkerPool> workers_;
 };
 
 }  // namespace demo_nodes_cpp
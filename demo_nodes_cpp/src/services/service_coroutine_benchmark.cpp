@@ -0,0 +1,259 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "example_interfaces/srv/add_two_ints.hpp"
+
+#include "demo_nodes_cpp/coroutine_client.hpp"
+#include "demo_nodes_cpp/latency_histogram.hpp"
+
+using namespace std::chrono_literals;
+
+// Compares two ways of keeping many AddTwoInts requests in flight at once.
+// "blocking" gives every outstanding request a thread of its own, which waits on the future of
+// the response, next to the thread spinning the client's executor.
+// "coroutine" runs as many coroutines on the executor's single thread, each of which co_awaits
+// the response, so a request in flight costs a coroutine frame instead of a thread.
+
+using example_interfaces::srv::AddTwoInts;
+using demo_nodes_cpp::LatencyHistogram;
+
+struct Options
+{
+  double duration = 2.0;
+  std::vector<size_t> concurrency{1, 8, 64, 256};
+};
+
+int64_t since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<AddTwoInts::Request> make_request()
+{
+  auto request = std::make_shared<AddTwoInts::Request>();
+  request->a = 2;
+  request->b = 3;
+  return request;
+}
+
+class BenchmarkClient : public rclcpp::Node
+{
+public:
+  BenchmarkClient()
+  : Node("service_coroutine_benchmark_client")
+  {
+    client_ = create_client<AddTwoInts>("service_coroutine_benchmark");
+  }
+
+  bool wait_for_service()
+  {
+    return client_->wait_for_service(5s);
+  }
+
+  rclcpp::Client<AddTwoInts>::SharedPtr client() const
+  {
+    return client_;
+  }
+
+  void start(size_t concurrency)
+  {
+    active_ = concurrency;
+    for (size_t i = 0; i < concurrency; ++i) {
+      send();
+    }
+  }
+
+  /// Have the coroutines return once their requests in flight are answered.
+  void stop()
+  {
+    running_ = false;
+  }
+
+  bool stopped() const
+  {
+    return active_ == 0;
+  }
+
+  LatencyHistogram latencies;
+
+private:
+  demo_nodes_cpp::Task send()
+  {
+    auto request = make_request();
+    while (running_) {
+      auto sent_at = std::chrono::steady_clock::now();
+      co_await demo_nodes_cpp::async_call(client_, request);
+      latencies.record(since(sent_at));
+    }
+    --active_;
+  }
+
+  std::atomic<bool> running_{true};
+  std::atomic<size_t> active_{0};
+  rclcpp::Client<AddTwoInts>::SharedPtr client_;
+};
+
+// Keep the given number of requests in flight for a while, and print one line of the report.
+void run(const Options & options, size_t concurrency, bool coroutines)
+{
+  auto node = std::make_shared<BenchmarkClient>();
+  if (!node->wait_for_service()) {
+    printf("The service didn't come up\n");
+    return;
+  }
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  LatencyHistogram latencies;
+  size_t threads = 1;
+  auto start = std::chrono::steady_clock::now();
+  std::thread executor_thread([&executor]() {executor.spin();});
+  if (coroutines) {
+    node->start(concurrency);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    node->stop();
+    while (!node->stopped() && rclcpp::ok()) {
+      std::this_thread::sleep_for(1ms);
+    }
+    latencies = node->latencies;
+  } else {
+    auto client = node->client();
+    std::atomic<bool> running{true};
+    std::vector<LatencyHistogram> thread_latencies(concurrency);
+    std::vector<std::thread> waiters;
+    for (size_t i = 0; i < concurrency; ++i) {
+      waiters.emplace_back(
+        [&client, &running, &latencies = thread_latencies[i]]() {
+          auto request = make_request();
+          while (running) {
+            auto sent_at = std::chrono::steady_clock::now();
+            auto future = client->async_send_request(request);
+            while (future.wait_for(100ms) != std::future_status::ready) {
+              if (!rclcpp::ok()) {
+                return;
+              }
+            }
+            latencies.record(since(sent_at));
+          }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    running = false;
+    for (auto & waiter : waiters) {
+      waiter.join();
+    }
+    for (const auto & thread_latency : thread_latencies) {
+      latencies.merge(thread_latency);
+    }
+    threads += concurrency;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  executor.cancel();
+  executor_thread.join();
+
+  printf(
+    "%-9s  %11zu  %7zu  %10.0f  %8.1f  %8.1f  %8.1f\n", coroutines ? "coroutine" : "blocking",
+    concurrency, threads, latencies.count() / seconds, latencies.percentile(0.5) / 1e3,
+    latencies.percentile(0.99) / 1e3, latencies.max() / 1e3);
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                 Print this help message.\n");
+  printf("  --duration S       Seconds to run each configuration for. Defaults to 2.\n");
+  printf("  --concurrency LIST Comma separated requests in flight. Defaults to 1,8,64,256.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      options.duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--concurrency")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--concurrency");
+      std::stringstream list(value ? value : "");
+      options.concurrency.clear();
+      for (std::string item; std::getline(list, item, ','); ) {
+        options.concurrency.push_back(std::stoul(item));
+      }
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (options.duration <= 0.0 || options.concurrency.empty()) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  for (size_t concurrency : options.concurrency) {
+    if (concurrency == 0) {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  rclcpp::init(argc, argv);
+
+  auto server = std::make_shared<rclcpp::Node>("service_coroutine_benchmark_server");
+  auto service = server->create_service<AddTwoInts>(
+    "service_coroutine_benchmark",
+    [](
+      const std::shared_ptr<AddTwoInts::Request> request,
+      std::shared_ptr<AddTwoInts::Response> response) {
+      response->sum = request->a + request->b;
+    });
+  rclcpp::executors::SingleThreadedExecutor server_executor;
+  server_executor.add_node(server);
+  std::thread server_thread([&server_executor]() {server_executor.spin();});
+
+  printf("mode       concurrency  threads  requests/s    p50 us    p99 us    max us\n");
+  for (size_t concurrency : options.concurrency) {
+    if (!rclcpp::ok()) {
+      break;
+    }
+    run(options, concurrency, false);
+    run(options, concurrency, true);
+  }
+
+  server_executor.cancel();
+  server_thread.join();
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Copyright 2023 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "demo_nodes_cpp/service_event_log.hpp"
+#include "demo_nodes_cpp/visibility_control.h"
+
+using namespace std::chrono_literals;
+
+// Records the introspection events of services to a binary log, which service_event_report
+// turns into the latency of every call. The events are taken serialized and only their info,
+// at a fixed place at the start, is read, so recording one costs a copy into the log's buffer.
+//
+// To see this in action, run the introspection demos, turn introspection on and record:
+//
+// ros2 launch demo_nodes_cpp introspect_services_launch.py
+// ros2 param set /introspection_service service_configure_introspection metadata
+// ros2 param set /introspection_client client_configure_introspection metadata
+// ros2 run demo_nodes_cpp service_event_recorder --ros-args -p file:=add_two_ints.log
+// ros2 run demo_nodes_cpp service_event_report add_two_ints.log
+
+namespace demo_nodes_cpp
+{
+
+class ServiceEventRecorder : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit ServiceEventRecorder(const rclcpp::NodeOptions & options)
+  : Node("service_event_recorder", options)
+  {
+    auto services = this->declare_parameter(
+      "services", std::vector<std::string>{"add_two_ints"});
+    std::string file = this->declare_parameter("file", std::string("service_events.log"));
+    // Keep the whole events, requests and responses included when introspection is set to
+    // 'contents', rather than just when and for which call they happened.
+    contents_ = this->declare_parameter("contents", false);
+    if (services.empty()) {
+      throw std::invalid_argument("services must name at least one service");
+    }
+
+    log_ = std::make_unique<ServiceEventLogWriter>(file);
+    for (const auto & service : services) {
+      Service recorded;
+      recorded.name = this->get_node_services_interface()->resolve_service_name(service);
+      recorded.topic = recorded.name + "/_service_event";
+      recorded.index = log_->add_service(recorded.name);
+      services_.push_back(std::move(recorded));
+    }
+    RCLCPP_INFO(
+      this->get_logger(), "Recording the events of %zu service(s) to '%s'", services_.size(),
+      file.c_str());
+
+    // The event topics only show up once introspection is turned on, so look for them until
+    // all of them were found.
+    discovery_timer_ = this->create_wall_timer(500ms, [this]() {discover();});
+    report_timer_ = this->create_wall_timer(1s, [this]() {report();});
+  }
+
+private:
+  struct Service
+  {
+    std::string name;
+    std::string topic;
+    uint16_t index = 0;
+    rclcpp::GenericSubscription::SharedPtr sub;
+  };
+
+  void discover()
+  {
+    auto topics = this->get_topic_names_and_types();
+    bool waiting = false;
+    for (auto & service : services_) {
+      if (service.sub) {
+        continue;
+      }
+      auto it = topics.find(service.topic);
+      if (it == topics.end() || it->second.empty()) {
+        waiting = true;
+        continue;
+      }
+      uint16_t index = service.index;
+      service.sub = this->create_generic_subscription(
+        service.topic, it->second.front(), rclcpp::SystemDefaultsQoS().keep_last(1000),
+        [this, index](std::shared_ptr<const rclcpp::SerializedMessage> msg) {
+          record(index, *msg);
+        });
+      RCLCPP_INFO(this->get_logger(), "Recording '%s'", service.topic.c_str());
+    }
+    if (!waiting) {
+      discovery_timer_->cancel();
+    }
+  }
+
+  void record(uint16_t index, const rclcpp::SerializedMessage & msg)
+  {
+    const rcl_serialized_message_t & buffer = msg.get_rcl_serialized_message();
+    if (!log_->append(
+        index, this->now().nanoseconds(), buffer.buffer, buffer.buffer_length, contents_))
+    {
+      ++unreadable_;
+    }
+  }
+
+  /// Log how many events were recorded over the last second, and write them out.
+  void report()
+  {
+    log_->flush();
+    uint64_t events = log_->events() - reported_events_;
+    if (events == 0 && unreadable_ == 0) {
+      return;
+    }
+    RCLCPP_INFO(
+      this->get_logger(), "Recorded %" PRIu64 " events (%" PRIu64 " bytes), %" PRIu64
+      " unreadable", events, log_->bytes() - reported_bytes_, unreadable_);
+    reported_events_ = log_->events();
+    reported_bytes_ = log_->bytes();
+    unreadable_ = 0;
+  }
+
+  bool contents_ = false;
+  std::unique_ptr<ServiceEventLogWriter> log_;
+  std::vector<Service> services_;
+  uint64_t reported_events_ = 0;
+  uint64_t reported_bytes_ = 0;
+  uint64_t unreadable_ = 0;
+  rclcpp::TimerBase::SharedPtr discovery_timer_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::ServiceEventRecorder)
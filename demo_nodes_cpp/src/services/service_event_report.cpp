@@ -0,0 +1,230 @@
+// Copyright 2023 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rcutils/cmdline_parser.h"
+
+#include "demo_nodes_cpp/latency_histogram.hpp"
+#include "demo_nodes_cpp/service_event_log.hpp"
+
+// Reads a log written by service_event_recorder, and pairs up the events of every call, by the
+// client's GID and the sequence number, to print the latency of the calls per service:
+// - "client" from the request being sent until the response was received, on the client's
+//   clock, which is what the caller waited;
+// - "server" from the request being received until the response was sent, on the server's
+//   clock, which is what the service callback took.
+// Only calls whose client, or server, had introspection on have the respective latency.
+
+using demo_nodes_cpp::LatencyHistogram;
+using demo_nodes_cpp::ServiceEventRecord;
+using demo_nodes_cpp::ServiceEventType;
+
+struct Call
+{
+  // The stamps of the events, indexed by ServiceEventType, 0 for those not seen.
+  int64_t stamps[4] = {0, 0, 0, 0};
+};
+
+struct CallKey
+{
+  uint16_t service;
+  std::array<uint8_t, 16> client_gid;
+  int64_t sequence_number;
+
+  bool operator==(const CallKey & other) const
+  {
+    return service == other.service && sequence_number == other.sequence_number &&
+           client_gid == other.client_gid;
+  }
+};
+
+struct CallKeyHash
+{
+  size_t operator()(const CallKey & key) const
+  {
+    // FNV-1a over the fields.
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void * data, size_t size) {
+        const uint8_t * bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+          hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+      };
+    mix(&key.service, sizeof(key.service));
+    mix(key.client_gid.data(), key.client_gid.size());
+    mix(&key.sequence_number, sizeof(key.sequence_number));
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct ServiceReport
+{
+  uint64_t calls = 0;
+  LatencyHistogram client;
+  LatencyHistogram server;
+};
+
+int64_t stamp(const Call & call, ServiceEventType type)
+{
+  return call.stamps[static_cast<size_t>(type)];
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options] FILE\n", executable);
+  printf("  -h            Print this help message.\n");
+  printf("  --start S     Skip the events recorded in the first S seconds of the log.\n");
+  printf("  --end S       Stop at the events recorded S seconds into the log.\n");
+  printf("  --calls       Print a line with the latencies of every call.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (argc < 2 || rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return argc < 2 ? 1 : 0;
+  }
+  double start_seconds = 0.0;
+  double end_seconds = std::numeric_limits<double>::infinity();
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--start")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--start");
+      start_seconds = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--end")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--end");
+      end_seconds = std::stod(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  const bool print_calls = rcutils_cli_option_exist(argv, end, "--calls");
+  const char * path = argv[argc - 1];
+  if (path[0] == '-' || start_seconds < 0.0 || end_seconds < start_seconds) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    demo_nodes_cpp::ServiceEventLogReader log(path);
+    if (!log.indexed()) {
+      printf("'%s' has no index, reading it from the start\n", path);
+    }
+    ServiceEventRecord record;
+    std::unordered_map<CallKey, Call, CallKeyHash> calls;
+    int64_t first = log.first_received_ns();
+    uint64_t events = 0;
+    bool started = false;
+    if (start_seconds > 0.0 && log.indexed()) {
+      log.seek(first + static_cast<int64_t>(start_seconds * 1e9));
+    }
+    while (log.next(record)) {
+      if (!started) {
+        started = true;
+        first = first != 0 ? first : record.received_ns;
+      }
+      double seconds = (record.received_ns - first) / 1e9;
+      if (seconds < start_seconds) {
+        continue;
+      }
+      if (seconds > end_seconds) {
+        break;
+      }
+      ++events;
+      CallKey key{record.service, record.info.client_gid, record.info.sequence_number};
+      calls[key].stamps[static_cast<size_t>(record.info.event_type)] = record.info.stamp_ns;
+    }
+
+    const auto & names = log.services();
+    std::vector<ServiceReport> reports(names.size());
+    if (print_calls) {
+      printf("service,client_gid,sequence_number,client_us,server_us\n");
+    }
+    for (const auto & [key, call] : calls) {
+      if (key.service >= reports.size()) {
+        continue;
+      }
+      ServiceReport & report = reports[key.service];
+      ++report.calls;
+      int64_t client = 0;
+      int64_t server = 0;
+      const bool has_client = stamp(call, ServiceEventType::RequestSent) != 0 &&
+        stamp(call, ServiceEventType::ResponseReceived) != 0;
+      const bool has_server = stamp(call, ServiceEventType::RequestReceived) != 0 &&
+        stamp(call, ServiceEventType::ResponseSent) != 0;
+      if (has_client) {
+        client = stamp(call, ServiceEventType::ResponseReceived) -
+          stamp(call, ServiceEventType::RequestSent);
+        report.client.record(client);
+      }
+      if (has_server) {
+        server = stamp(call, ServiceEventType::ResponseSent) -
+          stamp(call, ServiceEventType::RequestReceived);
+        report.server.record(server);
+      }
+      if (print_calls) {
+        // The latencies which are missing are left empty.
+        char gid[33];
+        for (size_t i = 0; i < key.client_gid.size(); ++i) {
+          snprintf(gid + 2 * i, 3, "%02x", key.client_gid[i]);
+        }
+        char client_us[32] = "";
+        char server_us[32] = "";
+        if (has_client) {
+          snprintf(client_us, sizeof(client_us), "%.1f", client / 1e3);
+        }
+        if (has_server) {
+          snprintf(server_us, sizeof(server_us), "%.1f", server / 1e3);
+        }
+        printf(
+          "%s,%s,%" PRId64 ",%s,%s\n", names[key.service].c_str(), gid, key.sequence_number,
+          client_us, server_us);
+      }
+    }
+
+    printf("%" PRIu64 " events of %zu calls\n", events, calls.size());
+    printf(
+      "%-24s  %8s  %6s  %9s  %9s  %9s  %6s  %9s  %9s  %9s\n", "service", "calls",
+      "client", "p50 us", "p99 us", "max us", "server", "p50 us", "p99 us", "max us");
+    for (size_t i = 0; i < reports.size(); ++i) {
+      const ServiceReport & report = reports[i];
+      printf(
+        "%-24s  %8" PRIu64 "  %6" PRIu64 "  %9.1f  %9.1f  %9.1f  %6" PRIu64
+        "  %9.1f  %9.1f  %9.1f\n",
+        names[i].c_str(), report.calls,
+        report.client.count(), report.client.percentile(0.5) / 1e3,
+        report.client.percentile(0.99) / 1e3, report.client.max() / 1e3,
+        report.server.count(), report.server.percentile(0.5) / 1e3,
+        report.server.percentile(0.99) / 1e3, report.server.max() / 1e3);
+    }
+  } catch (const std::runtime_error & e) {
+    printf("%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,235 @@
+// Copyright 2023 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "rcl/service_introspection.h"
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "example_interfaces/srv/add_two_ints.hpp"
+
+#include "demo_nodes_cpp/latency_histogram.hpp"
+
+using namespace std::chrono_literals;
+
+// Measures what service introspection costs: an AddTwoInts client keeps a window of requests
+// in flight to a server, with the introspection of both turned off, to 'metadata' and to
+// 'contents' in turn, while a subscription takes the events, as a recorder would.
+// It prints the requests per second of each level, how they compare to introspection being
+// off, and how many events a second were published.
+
+using example_interfaces::srv::AddTwoInts;
+using demo_nodes_cpp::LatencyHistogram;
+
+struct Options
+{
+  double duration = 2.0;
+  size_t in_flight = 8;
+};
+
+struct Level
+{
+  const char * name;
+  rcl_service_introspection_state_t state;
+};
+
+class BenchmarkNode : public rclcpp::Node
+{
+public:
+  BenchmarkNode(const std::string & name, size_t in_flight)
+  : Node(name), in_flight_(in_flight)
+  {
+  }
+
+  void serve()
+  {
+    service_ = create_service<AddTwoInts>(
+      "service_introspection_benchmark",
+      [](
+        const std::shared_ptr<AddTwoInts::Request> request,
+        std::shared_ptr<AddTwoInts::Response> response) {
+        response->sum = request->a + request->b;
+      });
+  }
+
+  bool connect()
+  {
+    client_ = create_client<AddTwoInts>("service_introspection_benchmark");
+    return client_->wait_for_service(5s);
+  }
+
+  void configure(rcl_service_introspection_state_t state)
+  {
+    if (service_) {
+      service_->configure_introspection(this->get_clock(), rclcpp::SystemDefaultsQoS(), state);
+    }
+    if (client_) {
+      client_->configure_introspection(this->get_clock(), rclcpp::SystemDefaultsQoS(), state);
+    }
+  }
+
+  /// Count the events published on the service's event topic.
+  void subscribe()
+  {
+    events_sub_ = create_generic_subscription(
+      "service_introspection_benchmark/_service_event",
+      "example_interfaces/srv/AddTwoInts_Event", rclcpp::SystemDefaultsQoS().keep_last(1000),
+      [this](std::shared_ptr<const rclcpp::SerializedMessage>) {++events;});
+  }
+
+  void start()
+  {
+    for (size_t i = 0; i < in_flight_; ++i) {
+      send();
+    }
+  }
+
+  LatencyHistogram latencies;
+  std::atomic<uint64_t> events{0};
+
+private:
+  void send()
+  {
+    auto request = std::make_shared<AddTwoInts::Request>();
+    request->a = 2;
+    request->b = 3;
+    auto sent_at = std::chrono::steady_clock::now();
+    client_->async_send_request(
+      request, [this, sent_at](rclcpp::Client<AddTwoInts>::SharedFuture) {
+        latencies.record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - sent_at).count());
+        send();
+      });
+  }
+
+  size_t in_flight_;
+  rclcpp::Service<AddTwoInts>::SharedPtr service_;
+  rclcpp::Client<AddTwoInts>::SharedPtr client_;
+  rclcpp::GenericSubscription::SharedPtr events_sub_;
+};
+
+// Run the client and server with the given level of introspection, and print one line of the
+// report. Returns the requests per second.
+double run(const Options & options, const Level & level, double baseline)
+{
+  auto server = std::make_shared<BenchmarkNode>("service_introspection_benchmark_server", 0);
+  server->serve();
+  auto client =
+    std::make_shared<BenchmarkNode>("service_introspection_benchmark_client", options.in_flight);
+  if (!client->connect()) {
+    printf("The service didn't come up\n");
+    return 0.0;
+  }
+  server->configure(level.state);
+  client->configure(level.state);
+  auto recorder = std::make_shared<BenchmarkNode>("service_introspection_benchmark_events", 0);
+  recorder->subscribe();
+
+  rclcpp::executors::SingleThreadedExecutor server_executor;
+  server_executor.add_node(server);
+  rclcpp::executors::SingleThreadedExecutor client_executor;
+  client_executor.add_node(client);
+  rclcpp::executors::SingleThreadedExecutor recorder_executor;
+  recorder_executor.add_node(recorder);
+  std::thread server_thread([&server_executor]() {server_executor.spin();});
+  std::thread recorder_thread([&recorder_executor]() {recorder_executor.spin();});
+
+  client->start();
+  auto start = std::chrono::steady_clock::now();
+  std::thread client_thread([&client_executor]() {client_executor.spin();});
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+  client_executor.cancel();
+  client_thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  server_executor.cancel();
+  server_thread.join();
+  recorder_executor.cancel();
+  recorder_thread.join();
+
+  const LatencyHistogram & latencies = client->latencies;
+  double rate = latencies.count() / seconds;
+  printf(
+    "%-9s  %10.0f  %6.1f%%  %8.1f  %8.1f  %9.0f\n", level.name, rate,
+    baseline > 0.0 ? 100.0 * rate / baseline : 100.0, latencies.percentile(0.5) / 1e3,
+    latencies.percentile(0.99) / 1e3, recorder->events / seconds);
+  return rate;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --duration S      Seconds to run each level for. Defaults to 2.\n");
+  printf("  --in-flight N     Requests the client keeps in flight. Defaults to 8.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      options.duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--in-flight")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--in-flight");
+      options.in_flight = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (options.duration <= 0.0 || options.in_flight == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  const Level levels[] = {
+    {"disabled", RCL_SERVICE_INTROSPECTION_OFF},
+    {"metadata", RCL_SERVICE_INTROSPECTION_METADATA},
+    {"contents", RCL_SERVICE_INTROSPECTION_CONTENTS},
+  };
+  printf("level      requests/s   vs off    p50 us    p99 us   events/s\n");
+  double baseline = 0.0;
+  for (const Level & level : levels) {
+    if (!rclcpp::ok()) {
+      break;
+    }
+    double rate = run(options, level, baseline);
+    if (baseline == 0.0) {
+      baseline = rate;
+    }
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+// Copyright 2014 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+
+#include "example_interfaces/srv/add_two_ints.hpp"
+
+#include "demo_nodes_cpp/latency_histogram.hpp"
+#include "demo_nodes_cpp/worker_pool.hpp"
+
+using namespace std::chrono_literals;
+
+// Measures how the throughput of an AddTwoInts service scales with threads.
+// The server's service is in a reentrant callback group, spun by a multi-threaded executor, and
+// every request keeps a thread busy for a while. It either answers in the callback, on the
+// executor's threads ("inline"), or defers the response to as many worker threads, with a single
+// executor thread taking the requests ("deferred"). Either way, that many threads do the work.
+// Clients on an executor of their own keep a window of requests in flight each.
+
+using example_interfaces::srv::AddTwoInts;
+using demo_nodes_cpp::LatencyHistogram;
+
+struct Options
+{
+  double duration = 2.0;
+  std::chrono::microseconds work{100};
+  size_t clients = 4;
+  size_t in_flight = 8;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+class BenchmarkServer : public rclcpp::Node
+{
+public:
+  BenchmarkServer(std::chrono::microseconds work, size_t deferred_workers)
+  : Node("service_throughput_benchmark_server"), work_(work)
+  {
+    auto group = this->create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+    if (deferred_workers > 0) {
+      workers_ = std::make_unique<demo_nodes_cpp::WorkerPool>(deferred_workers);
+      srv_ = create_service<AddTwoInts>(
+        "service_throughput_benchmark",
+        [this](
+          const std::shared_ptr<rclcpp::Service<AddTwoInts>> service,
+          const std::shared_ptr<rmw_request_id_t> request_header,
+          const std::shared_ptr<AddTwoInts::Request> request) {
+          workers_->post(
+            [this, service, request_header, request]() {
+              AddTwoInts::Response response;
+              demo_nodes_cpp::busy_wait(work_);
+              response.sum = request->a + request->b;
+              service->send_response(*request_header, response);
+            });
+        }, rclcpp::ServicesQoS(), group);
+    } else {
+      srv_ = create_service<AddTwoInts>(
+        "service_throughput_benchmark",
+        [this](
+          const std::shared_ptr<rmw_request_id_t>,
+          const std::shared_ptr<AddTwoInts::Request> request,
+          std::shared_ptr<AddTwoInts::Response> response) {
+          demo_nodes_cpp::busy_wait(work_);
+          response->sum = request->a + request->b;
+        }, rclcpp::ServicesQoS(), group);
+    }
+  }
+
+private:
+  std::chrono::microseconds work_;
+  rclcpp::Service<AddTwoInts>::SharedPtr srv_;
+  std::unique_ptr<demo_nodes_cpp::WorkerPool> workers_;
+};
+
+// Clients which each send a new request whenever one of theirs is answered.
+class BenchmarkClients : public rclcpp::Node
+{
+public:
+  BenchmarkClients(size_t clients, size_t in_flight)
+  : Node("service_throughput_benchmark_clients"), in_flight_(in_flight)
+  {
+    for (size_t i = 0; i < clients; ++i) {
+      clients_.push_back(create_client<AddTwoInts>("service_throughput_benchmark"));
+    }
+  }
+
+  bool wait_for_service()
+  {
+    return clients_.front()->wait_for_service(5s);
+  }
+
+  void start()
+  {
+    for (size_t client = 0; client < clients_.size(); ++client) {
+      for (size_t i = 0; i < in_flight_; ++i) {
+        send(client);
+      }
+    }
+  }
+
+  LatencyHistogram latencies;
+
+private:
+  void send(size_t client)
+  {
+    auto request = std::make_shared<AddTwoInts::Request>();
+    request->a = 2;
+    request->b = 3;
+    auto sent_at = std::chrono::steady_clock::now();
+    clients_[client]->async_send_request(
+      request, [this, client, sent_at](rclcpp::Client<AddTwoInts>::SharedFuture) {
+        latencies.record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - sent_at).count());
+        send(client);
+      });
+  }
+
+  size_t in_flight_;
+  std::vector<rclcpp::Client<AddTwoInts>::SharedPtr> clients_;
+};
+
+// Serve requests with the given number of threads for a while, and print one line of the report.
+void run(const Options & options, size_t threads, bool deferred)
+{
+  auto server = std::make_shared<BenchmarkServer>(options.work, deferred ? threads : 0);
+  auto clients = std::make_shared<BenchmarkClients>(options.clients, options.in_flight);
+  if (!clients->wait_for_service()) {
+    printf("The service didn't come up\n");
+    return;
+  }
+
+  // Deferring adds one thread which only hands the requests on.
+  rclcpp::executors::MultiThreadedExecutor server_executor(
+    rclcpp::ExecutorOptions(), deferred ? 1 : threads);
+  server_executor.add_node(server);
+  rclcpp::executors::SingleThreadedExecutor client_executor;
+  client_executor.add_node(clients);
+  std::thread server_thread([&server_executor]() {server_executor.spin();});
+
+  clients->start();
+  auto start = std::chrono::steady_clock::now();
+  std::thread client_thread([&client_executor]() {client_executor.spin();});
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+  client_executor.cancel();
+  client_thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  server_executor.cancel();
+  server_thread.join();
+
+  const LatencyHistogram & latencies = clients->latencies;
+  printf(
+    "%7zu  %-8s  %10.0f  %8.1f  %8.1f  %8.1f\n", threads, deferred ? "deferred" : "inline",
+    latencies.count() / seconds, latencies.percentile(0.5) / 1e3,
+    latencies.percentile(0.99) / 1e3, latencies.max() / 1e3);
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --duration S      Seconds to run each configuration for. Defaults to 2.\n");
+  printf("  --work-us N       Microseconds of work per request. Defaults to 100.\n");
+  printf("  --clients N       Clients sending requests. Defaults to 4.\n");
+  printf("  --in-flight N     Requests each client keeps in flight. Defaults to 8.\n");
+  printf("  --max-threads N   Most server threads, counts double. Defaults to the cores.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      options.duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--work-us")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--work-us");
+      options.work = std::chrono::microseconds(std::stoul(value ? value : ""));
+    }
+    if (rcutils_cli_option_exist(argv, end, "--clients")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--clients");
+      options.clients = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--in-flight")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--in-flight");
+      options.in_flight = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--max-threads")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--max-threads");
+      options.max_threads = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (options.duration <= 0.0 || options.clients == 0 || options.in_flight == 0 ||
+    options.max_threads == 0)
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  printf("threads  response  requests/s    p50 us    p99 us    max us\n");
+  for (size_t threads = 1; rclcpp::ok(); threads *= 2) {
+    threads = std::min(threads, options.max_threads);
+    run(options, threads, false);
+    run(options, threads, true);
+    if (threads == options.max_threads) {
+      break;
+    }
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,246 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "demo_nodes_cpp/thread_caching_allocator.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/allocator/allocator_common.hpp"
+#include "rclcpp/strategies/allocator_memory_strategy.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "std_msgs/msg/u_int32.hpp"
+
+using namespace std::chrono_literals;
+
+// Measures how an allocator holds up when many executor threads allocate and free at once.
+// A multi-threaded executor runs one publisher and one subscription per thread, each in a
+// callback group of its own, so publishing and receiving happen concurrently on all threads.
+// Messages are allocated by the thread which publishes them and usually freed by another one.
+// The report compares std::allocator (malloc) with ThreadCachingAllocator.
+
+using demo_nodes_cpp::ThreadCachingAllocator;
+using demo_nodes_cpp::ThreadCachingHeap;
+
+// Messages received by one subscription, on a cache line of its own.
+struct alignas(64) Counter
+{
+  std::atomic<uint64_t> value{0};
+};
+
+template<typename Alloc>
+class ContentionNode : public rclcpp::Node
+{
+public:
+  using MessageAllocTraits = rclcpp::allocator::AllocRebind<std_msgs::msg::UInt32, Alloc>;
+  using MessageAlloc = typename MessageAllocTraits::allocator_type;
+  using MessageDeleter = rclcpp::allocator::Deleter<MessageAlloc, std_msgs::msg::UInt32>;
+  using MessageUniquePtr = std::unique_ptr<std_msgs::msg::UInt32, MessageDeleter>;
+
+  ContentionNode(size_t pairs, size_t burst, std::shared_ptr<Alloc> alloc)
+  : Node(
+      "allocator_contention_benchmark", rclcpp::NodeOptions().use_intra_process_comms(true)),
+    published_(pairs), received_(pairs), message_alloc_(*alloc)
+  {
+    rclcpp::allocator::set_allocator_for_deleter(&message_deleter_, &message_alloc_);
+    for (size_t i = 0; i < pairs; ++i) {
+      std::string topic = "allocator_contention_" + std::to_string(i);
+      rclcpp::PublisherOptionsWithAllocator<Alloc> publisher_options;
+      publisher_options.allocator = alloc;
+      auto publisher = this->create_publisher<std_msgs::msg::UInt32>(
+        topic, 100, publisher_options);
+
+      rclcpp::SubscriptionOptionsWithAllocator<Alloc> subscription_options;
+      subscription_options.allocator = alloc;
+      subscription_options.callback_group =
+        this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+      auto msg_mem_strat = std::make_shared<
+        rclcpp::message_memory_strategy::MessageMemoryStrategy<
+          std_msgs::msg::UInt32, Alloc>>(alloc);
+      Counter & received = received_[i];
+      subscriptions_.push_back(
+        this->create_subscription<std_msgs::msg::UInt32>(
+          topic, 100, [&received](std_msgs::msg::UInt32::ConstSharedPtr) {
+            received.value.fetch_add(1, std::memory_order_relaxed);
+          }, subscription_options, msg_mem_strat));
+
+      Counter & published = published_[i];
+      timers_.push_back(
+        this->create_wall_timer(
+          100us, [this, publisher, burst, &published]() {
+            for (size_t n = 0; n < burst; ++n) {
+              auto ptr = MessageAllocTraits::allocate(message_alloc_, 1);
+              MessageAllocTraits::construct(message_alloc_, ptr);
+              MessageUniquePtr msg(ptr, message_deleter_);
+              msg->data = static_cast<uint32_t>(n);
+              publisher->publish(std::move(msg));
+            }
+            published.value.fetch_add(burst, std::memory_order_relaxed);
+          },
+          this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive)));
+    }
+  }
+
+  uint64_t published() const
+  {
+    return sum(published_);
+  }
+
+  uint64_t received() const
+  {
+    return sum(received_);
+  }
+
+private:
+  static uint64_t sum(const std::vector<Counter> & counters)
+  {
+    uint64_t total = 0;
+    for (const auto & counter : counters) {
+      total += counter.value.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  std::vector<Counter> published_;
+  std::vector<Counter> received_;
+  MessageAlloc message_alloc_;
+  MessageDeleter message_deleter_;
+  std::vector<rclcpp::Subscription<std_msgs::msg::UInt32>::SharedPtr> subscriptions_;
+  std::vector<rclcpp::TimerBase::SharedPtr> timers_;
+};
+
+struct Result
+{
+  double published_per_second = 0.0;
+  double received_per_second = 0.0;
+  double cpu_us_per_message = 0.0;
+};
+
+// Spin a node with one publisher and subscription per thread on a multi-threaded executor whose
+// memory strategy uses the same allocator.
+template<typename Alloc>
+Result run(size_t threads, size_t burst, std::chrono::duration<double> duration, Alloc alloc)
+{
+  using rclcpp::memory_strategies::allocator_memory_strategy::AllocatorMemoryStrategy;
+  auto shared_alloc = std::make_shared<Alloc>(alloc);
+  auto node = std::make_shared<ContentionNode<Alloc>>(threads, burst, shared_alloc);
+
+  rclcpp::ExecutorOptions options;
+  options.memory_strategy = std::make_shared<AllocatorMemoryStrategy<Alloc>>(shared_alloc);
+  rclcpp::executors::MultiThreadedExecutor executor(options, threads);
+  executor.add_node(node);
+
+  std::clock_t cpu_start = std::clock();
+  auto start = std::chrono::steady_clock::now();
+  std::thread spinner([&executor]() {executor.spin();});
+  std::this_thread::sleep_for(duration);
+  executor.cancel();
+  spinner.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+  Result result;
+  result.published_per_second = node->published() / seconds;
+  result.received_per_second = node->received() / seconds;
+  if (node->received() > 0) {
+    result.cpu_us_per_message = cpu_seconds * 1e6 / node->received();
+  }
+  return result;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                Print this help message.\n");
+  printf("  --duration S      Seconds to run each configuration for. Defaults to 2.\n");
+  printf("  --burst N         Messages each publisher sends every 100 us. Defaults to 10.\n");
+  printf("  --min-threads N   Smallest executor thread count. Defaults to 8.\n");
+  printf("  --max-threads N   Largest executor thread count, counts double. Defaults to 32.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  double duration = 2.0;
+  size_t burst = 10;
+  size_t min_threads = 8;
+  size_t max_threads = 32;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--burst")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--burst");
+      burst = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--min-threads")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--min-threads");
+      min_threads = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--max-threads")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--max-threads");
+      max_threads = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (duration <= 0.0 || burst == 0 || min_threads == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  std::chrono::duration<double> seconds(duration);
+  printf(
+    "threads  allocator        published/s   received/s  cpu us/msg  "
+    "remote frees  reserved KiB\n");
+  for (size_t threads = min_threads; threads <= max_threads && rclcpp::ok(); threads *= 2) {
+    Result result = run(threads, burst, seconds, std::allocator<void>());
+    printf(
+      "%7zu  %-15s  %11.0f  %11.0f  %10.2f  %12s  %12s\n", threads, "std::allocator",
+      result.published_per_second, result.received_per_second, result.cpu_us_per_message,
+      "-", "-");
+
+    // A heap of its own for each run, so the counters and the reserved bytes are per run.
+    ThreadCachingHeap heap;
+    result = run(threads, burst, seconds, ThreadCachingAllocator<void>(heap));
+    ThreadCachingHeap::Stats stats = heap.stats();
+    uint64_t frees = stats.local_frees + stats.remote_frees;
+    printf(
+      "%7zu  %-15s  %11.0f  %11.0f  %10.2f  %11.1f%%  %12.1f\n", threads, "thread_caching",
+      result.published_per_second, result.received_per_second, result.cpu_us_per_message,
+      frees > 0 ? 100.0 * stats.remote_frees / frees : 0.0, stats.reserved_bytes / 1024.0);
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -13,11 +13,13 @@
 // limitations under the License.
 
 #include <chrono>
+#include <cinttypes>
 #include <list>
 #include <memory>
 #include <string>
 #include <utility>
 
+#include "demo_nodes_cpp/allocation_profiler.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/strategies/allocator_memory_strategy.hpp"
@@ -25,9 +27,8 @@
 
 using namespace std::chrono_literals;
 
-// For demonstration purposes only, not necessary for allocator_traits
-static uint32_t num_allocs = 0;
-static uint32_t num_deallocs = 0;
+using demo_nodes_cpp::AllocationProfiler;
+
 // A very simple custom allocator. Counts calls to allocate and deallocate.
 template<typename T = void>
 struct MyAllocator
@@ -55,7 +56,8 @@ public:
     if (size == 0) {
       return nullptr;
     }
-    num_allocs++;
+    AllocationProfiler::instance().allocated(
+      AllocationProfiler::Source::Allocator, size * sizeof(T));
     return static_cast<T *>(std::malloc(size * sizeof(T)));
   }
 
@@ -65,7 +67,7 @@ public:
     if (!ptr) {
       return;
     }
-    num_deallocs++;
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::Allocator);
     std::free(ptr);
   }
 
@@ -94,15 +96,9 @@ constexpr bool operator!=(
 
 // Override global new and delete to count calls during execution.
 
-static bool is_running = false;
-static uint32_t global_runtime_allocs = 0;
-static uint32_t global_runtime_deallocs = 0;
-
 void * operator new(std::size_t size)
 {
-  if (is_running) {
-    global_runtime_allocs++;
-  }
+  AllocationProfiler::instance().allocated(AllocationProfiler::Source::GlobalNew, size);
   return std::malloc(size);
 }
 
@@ -110,9 +106,7 @@ void operator delete(void * ptr, size_t size) noexcept
 {
   (void)size;
   if (ptr != nullptr) {
-    if (is_running) {
-      global_runtime_deallocs++;
-    }
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::GlobalNew);
     std::free(ptr);
   }
 }
@@ -120,9 +114,7 @@ void operator delete(void * ptr, size_t size) noexcept
 void operator delete(void * ptr) noexcept
 {
   if (ptr != nullptr) {
-    if (is_running) {
-      global_runtime_deallocs++;
-    }
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::GlobalNew);
     std::free(ptr);
   }
 }
@@ -150,7 +142,8 @@ int main(int argc, char ** argv)
     "command-line argument).  It will then publish a message to the\n"
     "'/allocator_tutorial' topic every 10 milliseconds until Ctrl-C is pressed.\n"
     "At that time it will print a count of the number of allocations and\n"
-    "deallocations that happened during the program.\n\n");
+    "deallocations that happened during the program, followed by a report\n"
+    "breaking them down by phase, size and call site.\n\n");
 
   if (argc > 1) {
     for (auto & key : keys) {
@@ -179,6 +172,7 @@ int main(int argc, char ** argv)
   uint32_t counter = 0;
   auto callback = [&counter](std_msgs::msg::UInt32::ConstSharedPtr msg) -> void
     {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Execute);
       (void)msg;
       ++counter;
     };
@@ -215,7 +209,8 @@ int main(int argc, char ** argv)
   rclcpp::allocator::set_allocator_for_deleter(&message_deleter, &message_alloc);
 
   rclcpp::sleep_for(1ms);
-  is_running = true;
+  auto & profiler = AllocationProfiler::instance();
+  profiler.start();
 
   uint32_t i = 0;
   while (rclcpp::ok()) {
@@ -226,19 +221,33 @@ int main(int argc, char ** argv)
     MessageUniquePtr msg(ptr, message_deleter);
     msg->data = i;
     ++i;
-    publisher->publish(std::move(msg));
+    {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Publish);
+      publisher->publish(std::move(msg));
+    }
     rclcpp::sleep_for(10ms);
-    executor.spin_some();
+    {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Take);
+      executor.spin_some();
+    }
   }
-  is_running = false;
+  profiler.stop();
 
-  uint32_t final_global_allocs = global_runtime_allocs;
-  uint32_t final_global_deallocs = global_runtime_deallocs;
-  printf("Global new was called %u times during spin\n", final_global_allocs);
-  printf("Global delete was called %u times during spin\n", final_global_deallocs);
+  printf(
+    "Global new was called %" PRIu64 " times during spin\n",
+    profiler.allocations(AllocationProfiler::Source::GlobalNew));
+  printf(
+    "Global delete was called %" PRIu64 " times during spin\n",
+    profiler.deallocations(AllocationProfiler::Source::GlobalNew));
+
+  printf(
+    "Allocator new was called %" PRIu64 " times during spin\n",
+    profiler.allocations(AllocationProfiler::Source::Allocator));
+  printf(
+    "Allocator delete was called %" PRIu64 " times during spin\n",
+    profiler.deallocations(AllocationProfiler::Source::Allocator));
 
-  printf("Allocator new was called %u times during spin\n", num_allocs);
-  printf("Allocator delete was called %u times during spin\n", num_deallocs);
+  profiler.print_report();
 
   return 0;
 }
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <chrono>
+#include <cinttypes>
 #include <list>
 #include <memory>
 #include <memory_resource>
@@ -20,6 +21,7 @@
 #include <string>
 #include <utility>
 
+#include "demo_nodes_cpp/allocation_profiler.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp/allocator/allocator_common.hpp"
 #include "rclcpp/strategies/allocator_memory_strategy.hpp"
@@ -27,16 +29,15 @@
 
 using namespace std::chrono_literals;
 
-// For demonstration purposes only, not necessary for allocator_traits
-static uint32_t num_allocs = 0;
-static uint32_t num_deallocs = 0;
+using demo_nodes_cpp::AllocationProfiler;
+
 // A very simple custom memory resource. Counts calls to do_allocate and do_deallocate.
 class CustomMemoryResource : public std::pmr::memory_resource
 {
 private:
   void * do_allocate(std::size_t bytes, std::size_t alignment) override
   {
-    num_allocs++;
+    AllocationProfiler::instance().allocated(AllocationProfiler::Source::Allocator, bytes);
     (void)alignment;
     return std::malloc(bytes);
   }
@@ -45,7 +46,7 @@ private:
     void * p, std::size_t bytes,
     std::size_t alignment) override
   {
-    num_deallocs++;
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::Allocator);
     (void)bytes;
     (void)alignment;
     std::free(p);
@@ -61,10 +62,6 @@ private:
 
 // Override global new and delete to count calls during execution.
 
-static bool is_running = false;
-static uint32_t global_runtime_allocs = 0;
-static uint32_t global_runtime_deallocs = 0;
-
 // Due to GCC bug https://gcc.gnu.org/bugzilla/show_bug.cgi?id=103993, we
 // always inline the overridden new and delete operators.
 
@@ -80,9 +77,7 @@ NOINLINE void * operator new(std::size_t size)
     ++size;
   }
 
-  if (is_running) {
-    global_runtime_allocs++;
-  }
+  AllocationProfiler::instance().allocated(AllocationProfiler::Source::GlobalNew, size);
 
   void * ptr = std::malloc(size);
   if (ptr != nullptr) {
@@ -96,9 +91,7 @@ NOINLINE void operator delete(void * ptr, size_t size) noexcept
 {
   (void)size;
   if (ptr != nullptr) {
-    if (is_running) {
-      global_runtime_deallocs++;
-    }
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::GlobalNew);
     std::free(ptr);
   }
 }
@@ -106,9 +99,7 @@ NOINLINE void operator delete(void * ptr, size_t size) noexcept
 NOINLINE void operator delete(void * ptr) noexcept
 {
   if (ptr != nullptr) {
-    if (is_running) {
-      global_runtime_deallocs++;
-    }
+    AllocationProfiler::instance().deallocated(AllocationProfiler::Source::GlobalNew);
     std::free(ptr);
   }
 }
@@ -136,7 +127,8 @@ int main(int argc, char ** argv)
     "command-line argument).  It will then publish a message to the\n"
     "'/allocator_tutorial' topic every 10 milliseconds until Ctrl-C is pressed.\n"
     "At that time it will print a count of the number of allocations and\n"
-    "deallocations that happened during the program.\n\n");
+    "deallocations that happened during the program, followed by a report\n"
+    "breaking them down by phase, size and call site.\n\n");
 
   if (argc > 1) {
     for (auto & key : keys) {
@@ -165,6 +157,7 @@ int main(int argc, char ** argv)
   uint32_t counter = 0;
   auto callback = [&counter](std_msgs::msg::UInt32::ConstSharedPtr msg) -> void
     {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Execute);
       (void)msg;
       ++counter;
     };
@@ -202,7 +195,8 @@ int main(int argc, char ** argv)
   rclcpp::allocator::set_allocator_for_deleter(&message_deleter, &message_alloc);
 
   rclcpp::sleep_for(1ms);
-  is_running = true;
+  auto & profiler = AllocationProfiler::instance();
+  profiler.start();
 
   uint32_t i = 0;
   while (rclcpp::ok()) {
@@ -213,19 +207,33 @@ int main(int argc, char ** argv)
     MessageUniquePtr msg(ptr, message_deleter);
     msg->data = i;
     ++i;
-    publisher->publish(std::move(msg));
+    {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Publish);
+      publisher->publish(std::move(msg));
+    }
     rclcpp::sleep_for(10ms);
-    executor.spin_some();
+    {
+      AllocationProfiler::Scope scope(AllocationProfiler::Phase::Take);
+      executor.spin_some();
+    }
   }
-  is_running = false;
+  profiler.stop();
 
-  uint32_t final_global_allocs = global_runtime_allocs;
-  uint32_t final_global_deallocs = global_runtime_deallocs;
-  printf("Global new was called %u times during spin\n", final_global_allocs);
-  printf("Global delete was called %u times during spin\n", final_global_deallocs);
+  printf(
+    "Global new was called %" PRIu64 " times during spin\n",
+    profiler.allocations(AllocationProfiler::Source::GlobalNew));
+  printf(
+    "Global delete was called %" PRIu64 " times during spin\n",
+    profiler.deallocations(AllocationProfiler::Source::GlobalNew));
+
+  printf(
+    "Allocator new was called %" PRIu64 " times during spin\n",
+    profiler.allocations(AllocationProfiler::Source::Allocator));
+  printf(
+    "Allocator delete was called %" PRIu64 " times during spin\n",
+    profiler.deallocations(AllocationProfiler::Source::Allocator));
 
-  printf("Allocator new was called %u times during spin\n", num_allocs);
-  printf("Allocator delete was called %u times during spin\n", num_deallocs);
+  profiler.print_report();
 
   return 0;
 }
@@ -0,0 +1,291 @@
+// Copyright 2022 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialization.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "std_msgs/msg/header.hpp"
+
+#include "demo_nodes_cpp/content_filter.hpp"
+#include "demo_nodes_cpp/latency_histogram.hpp"
+
+using namespace std::chrono_literals;
+
+// Measures what content filtering saves at high rates.
+// A publisher sends std_msgs/msg/Header messages whose frame_id holds the payload. The first two
+// characters of frame_id cycle through "00" to "99", so the filter "frame_id < '10'" passes 10%
+// of the messages, and so on. The stamp holds the time of publishing on the steady clock, for
+// the latency; publisher and subscriber share the process, so they share that clock.
+// Each subscription uses that filter: in the middleware if it supports content filtering, which
+// can then drop messages on the writer side, and otherwise with demo_nodes_cpp::ContentFilter on
+// the serialized messages in the subscriber.
+
+using demo_nodes_cpp::LatencyHistogram;
+
+// Nanoseconds on the clock of the stamps, which, unlike the system clock, is never adjusted.
+int64_t steady_time_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double thread_cpu_seconds()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+// Subscriptions which all filter the same topic, and the latencies of what reaches them.
+class FilteredSubscriber : public rclcpp::Node
+{
+public:
+  FilteredSubscriber(size_t count, size_t selectivity)
+  : Node("content_filtering_benchmark_subscriber")
+  {
+    rclcpp::SubscriptionOptions options;
+    // A selectivity of 100% takes no filter at all, as the baseline.
+    if (selectivity < 100) {
+      std::string bound = std::to_string(selectivity);
+      options.content_filter_options.filter_expression = "frame_id < %0";
+      options.content_filter_options.expression_parameters = {
+        "'" + std::string(2 - bound.size(), '0') + bound + "'"};
+    }
+    for (size_t i = 0; i < count; ++i) {
+      auto sub = create_subscription<std_msgs::msg::Header>(
+        "content_filtering_benchmark", 100,
+        [this](const std_msgs::msg::Header & msg) {record(msg);}, options);
+      if (selectivity < 100 && !sub->is_cft_enabled()) {
+        if (!filter_) {
+          filter_ = std::make_unique<demo_nodes_cpp::ContentFilter>(
+            demo_nodes_cpp::ContentFilter::create<std_msgs::msg::Header>(
+              options.content_filter_options.filter_expression,
+              options.content_filter_options.expression_parameters));
+        }
+        sub = create_subscription<std_msgs::msg::Header>(
+          "content_filtering_benchmark", 100,
+          [this](const std::shared_ptr<rclcpp::SerializedMessage> serialized) {
+            if (filter_->matches(*serialized)) {
+              serializer_.deserialize_message(serialized.get(), &msg_);
+              record(msg_);
+            }
+          });
+      }
+      subscriptions_.push_back(sub);
+    }
+  }
+
+  /// Where the filter runs: "middleware", "local" or "none".
+  const char * filtering() const
+  {
+    return filter_ ? "local" : subscriptions_.front()->is_cft_enabled() ? "middleware" : "none";
+  }
+
+  LatencyHistogram latencies;
+
+private:
+  void record(const std_msgs::msg::Header & msg)
+  {
+    latencies.record(steady_time_ns() - (msg.stamp.sec * 1000000000LL + msg.stamp.nanosec));
+  }
+
+  std::unique_ptr<demo_nodes_cpp::ContentFilter> filter_;
+  rclcpp::Serialization<std_msgs::msg::Header> serializer_;
+  std_msgs::msg::Header msg_;
+  std::vector<rclcpp::Subscription<std_msgs::msg::Header>::SharedPtr> subscriptions_;
+};
+
+struct Options
+{
+  double rate = 10000.0;
+  double duration = 2.0;
+  size_t subscribers = 1;
+  std::vector<size_t> selectivities{1, 10, 50, 100};
+  std::vector<size_t> sizes{64, 1024, 16384};
+};
+
+// One configuration: messages of the given size at the configured rate, to subscribers whose
+// filter passes the given percentage of them.
+void run(const Options & options, size_t size, size_t selectivity)
+{
+  auto publisher_node = rclcpp::Node::make_shared("content_filtering_benchmark_publisher");
+  auto pub = publisher_node->create_publisher<std_msgs::msg::Header>(
+    "content_filtering_benchmark", 100);
+  auto subscriber = std::make_shared<FilteredSubscriber>(options.subscribers, selectivity);
+
+  // Give discovery a moment, so the first messages aren't lost.
+  auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (pub->get_subscription_count() < options.subscribers &&
+    std::chrono::steady_clock::now() < deadline && rclcpp::ok())
+  {
+    std::this_thread::sleep_for(10ms);
+  }
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(subscriber);
+  std::atomic<double> subscriber_cpu{0.0};
+  std::thread spinner([&executor, &subscriber_cpu]() {
+      double start = thread_cpu_seconds();
+      executor.spin();
+      subscriber_cpu = thread_cpu_seconds() - start;
+    });
+
+  std_msgs::msg::Header msg;
+  msg.frame_id.assign(std::max<size_t>(size, 2), 'x');
+  std::clock_t process_start = std::clock();
+  double publisher_start = thread_cpu_seconds();
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(options.duration));
+  size_t published = 0;
+  while (rclcpp::ok()) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= end) {
+      break;
+    }
+    // Catch up with the rate, then sleep a little.
+    size_t due = static_cast<size_t>(
+      std::chrono::duration<double>(now - start).count() * options.rate);
+    for (; published < due; ++published) {
+      msg.frame_id[0] = static_cast<char>('0' + published % 100 / 10);
+      msg.frame_id[1] = static_cast<char>('0' + published % 10);
+      int64_t stamp = steady_time_ns();
+      msg.stamp.sec = static_cast<int32_t>(stamp / 1000000000);
+      msg.stamp.nanosec = static_cast<uint32_t>(stamp % 1000000000);
+      pub->publish(msg);
+    }
+    std::this_thread::sleep_for(100us);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double publisher_cpu = thread_cpu_seconds() - publisher_start;
+  // Let the last messages arrive.
+  std::this_thread::sleep_for(100ms);
+  executor.cancel();
+  spinner.join();
+  double process_cpu = static_cast<double>(std::clock() - process_start) / CLOCKS_PER_SEC;
+
+  // Message i passes if i % 100 < selectivity; whatever passes but doesn't arrive was lost,
+  // e.g. dropped from a full queue, rather than filtered out.
+  size_t offered = published * options.subscribers;
+  size_t passing =
+    (published / 100 * selectivity + std::min(published % 100, selectivity)) * options.subscribers;
+  size_t delivered = subscriber->latencies.count();
+  printf(
+    "%7zu  %5zu%%  %4zu  %-10s  %11.0f  %11.0f  %10.0f  %8.0f  %7.1f  %7.1f  %8.1f  %8.1f  "
+    "%8.1f\n",
+    size, selectivity, options.subscribers, subscriber->filtering(), published / seconds,
+    delivered / seconds, (offered - passing) / seconds,
+    (passing > delivered ? passing - delivered : 0) / seconds,
+    100.0 * publisher_cpu / seconds, 100.0 * subscriber_cpu / seconds,
+    100.0 * process_cpu / seconds,
+    subscriber->latencies.percentile(0.5) / 1e3, subscriber->latencies.percentile(0.99) / 1e3);
+}
+
+// Parse a comma separated list of numbers.
+std::vector<size_t> parse_list(const char * value)
+{
+  std::vector<size_t> list;
+  std::string text(value ? value : "");
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    size_t comma = std::min(text.find(',', begin), text.size());
+    list.push_back(std::stoul(text.substr(begin, comma - begin)));
+    begin = comma + 1;
+  }
+  return list;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                  Print this help message.\n");
+  printf("  --rate N            Messages to publish per second. Defaults to 10000.\n");
+  printf("  --duration S        Seconds to run each configuration for. Defaults to 2.\n");
+  printf("  --subscribers N     Subscriptions to the topic. Defaults to 1.\n");
+  printf("  --selectivity LIST  Percentages of messages to pass. Defaults to 1,10,50,100.\n");
+  printf("  --sizes LIST        Payload sizes in bytes. Defaults to 64,1024,16384.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  Options options;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--rate")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--rate");
+      options.rate = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      options.duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--subscribers")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--subscribers");
+      options.subscribers = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--selectivity")) {
+      options.selectivities = parse_list(rcutils_cli_get_option(argv, end, "--selectivity"));
+    }
+    if (rcutils_cli_option_exist(argv, end, "--sizes")) {
+      options.sizes = parse_list(rcutils_cli_get_option(argv, end, "--sizes"));
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  bool valid = options.rate > 0.0 && options.duration > 0.0 && options.subscribers > 0;
+  for (size_t selectivity : options.selectivities) {
+    valid = valid && selectivity > 0 && selectivity <= 100;
+  }
+  if (!valid) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  printf(
+    "   size    pass  subs  filter      published/s  delivered/s  filtered/s    lost/s  "
+    "pub cpu  sub cpu   all cpu    p50 us    p99 us\n");
+  for (size_t size : options.sizes) {
+    for (size_t selectivity : options.selectivities) {
+      if (!rclcpp::ok()) {
+        break;
+      }
+      run(options, size, selectivity);
+    }
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -13,14 +13,17 @@
 // limitations under the License.
 
 #include <array>
+#include <memory>
 #include <string>
 
 #include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialization.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
 #include "rcpputils/join.hpp"
 
 #include "std_msgs/msg/float32.hpp"
 
+#include "demo_nodes_cpp/content_filter.hpp"
 #include "demo_nodes_cpp/visibility_control.h"
 
 namespace demo_nodes_cpp
@@ -64,6 +67,28 @@ public:
     if (!sub_->is_cft_enabled()) {
       RCLCPP_WARN(
         this->get_logger(), "Content filter is not enabled since it's not supported");
+      // Filter here instead. The subscription takes the serialized messages, and only the ones
+      // which pass the filter are deserialized and handed to the callback.
+      filter_ = std::make_unique<ContentFilter>(
+        ContentFilter::create<std_msgs::msg::Float32>(
+          sub_options.content_filter_options.filter_expression,
+          sub_options.content_filter_options.expression_parameters));
+      auto filtered_callback =
+        [this, callback](const std::shared_ptr<rclcpp::SerializedMessage> serialized) -> void
+        {
+          if (!filter_->matches(*serialized)) {
+            return;
+          }
+          serializer_.deserialize_message(serialized.get(), &msg_);
+          callback(msg_);
+        };
+      sub_ = create_subscription<std_msgs::msg::Float32>("temperature", 10, filtered_callback);
+      RCLCPP_INFO(
+        this->get_logger(),
+        "filtering topic \"%s\" locally with content filter options \"%s, {%s}\"",
+        sub_->get_topic_name(),
+        sub_options.content_filter_options.filter_expression.c_str(),
+        rcpputils::join(sub_options.content_filter_options.expression_parameters, ", ").c_str());
     } else {
       RCLCPP_INFO(
         this->get_logger(),
@@ -76,6 +101,9 @@ public:
 
 private:
   rclcpp::Subscription<std_msgs::msg::Float32>::SharedPtr sub_;
+  std::unique_ptr<ContentFilter> filter_;
+  rclcpp::Serialization<std_msgs::msg::Float32> serializer_;
+  std_msgs::msg::Float32 msg_;
 };
 
 }  // namespace demo_nodes_cpp
@@ -12,13 +12,23 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
 
 #include "std_msgs/msg/string.hpp"
 
+#include "demo_nodes_cpp/latency_histogram.hpp"
 #include "demo_nodes_cpp/visibility_control.h"
 
+using namespace std::chrono_literals;
+
 namespace demo_nodes_cpp
 {
 // Create a Listener class that subclasses the generic rclcpp::Node base class.
@@ -30,23 +40,100 @@ public:
   explicit Listener(const rclcpp::NodeOptions & options)
   : Node("listener", options)
   {
+    // Log every message, or else a summary of what was received each second: the rate, the
+    // messages lost or out of order, and the latency of messages from a probing talker.
+    // The summary is also published on chatter_summary.
+    log_messages_ = this->declare_parameter("log_messages", true);
+
     // Create a callback function for when messages are received.
     // Variations of this function also exist using, for example UniquePtr for zero-copy transport.
     setvbuf(stdout, NULL, _IONBF, BUFSIZ);
     auto callback =
       [this](std_msgs::msg::String::ConstSharedPtr msg) -> void
       {
-        RCLCPP_INFO(this->get_logger(), "I heard: [%s]", msg->data.c_str());
+        if (log_messages_) {
+          RCLCPP_INFO(this->get_logger(), "I heard: [%s]", msg->data.c_str());
+        }
+        record(msg->data.c_str());
       };
     // Create a subscription to the topic which can be matched with one or more compatible ROS
     // publishers.
     // Note that not all publishers on the same topic with the same type will be compatible:
     // they must have compatible Quality of Service policies.
     sub_ = create_subscription<std_msgs::msg::String>("chatter", 10, callback);
+    if (!log_messages_) {
+      summary_pub_ = this->create_publisher<std_msgs::msg::String>("chatter_summary", 10);
+      report_timer_ = this->create_wall_timer(1s, [this]() {report();});
+    }
   }
 
 private:
+  /// Take the count, and the time of publishing if the talker probes the latency, out of a
+  /// message of the form "Hello World: <count>[ t=<nanoseconds>]".
+  void record(const char * data)
+  {
+    static const char prefix[] = "Hello World: ";
+    ++received_;
+    if (std::strncmp(data, prefix, sizeof(prefix) - 1) != 0) {
+      return;
+    }
+    char * end = nullptr;
+    uint64_t count = std::strtoull(data + sizeof(prefix) - 1, &end, 10);
+    if (count == 1 || next_count_ == 0) {
+      // The talker was (re)started.
+      next_count_ = count + 1;
+    } else if (count >= next_count_) {
+      lost_ += count - next_count_;
+      next_count_ = count + 1;
+    } else {
+      // A message which was counted as lost arrived after all.
+      ++out_of_order_;
+      if (lost_ > 0) {
+        --lost_;
+      }
+    }
+    if (std::strncmp(end, " t=", 3) == 0) {
+      int64_t stamp = std::strtoll(end + 3, nullptr, 10);
+      int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+      latencies_.record(now - stamp);
+    }
+  }
+
+  /// Log and publish a summary of what was received over the last second.
+  void report()
+  {
+    if (received_ == 0) {
+      return;
+    }
+    summary_.data = "Received " + std::to_string(received_) + " messages/s, " +
+      std::to_string(lost_) + " lost, " + std::to_string(out_of_order_) + " out of order";
+    if (latencies_.count() > 0) {
+      char latency[128];
+      snprintf(
+        latency, sizeof(latency), ", latency p50 %.1f us, p99 %.1f us, max %.1f us",
+        latencies_.percentile(0.5) / 1e3, latencies_.percentile(0.99) / 1e3,
+        latencies_.max() / 1e3);
+      summary_.data += latency;
+    }
+    RCLCPP_INFO(this->get_logger(), "%s", summary_.data.c_str());
+    summary_pub_->publish(summary_);
+    received_ = 0;
+    lost_ = 0;
+    out_of_order_ = 0;
+    latencies_.reset();
+  }
+
+  bool log_messages_ = true;
+  size_t received_ = 0;
+  size_t lost_ = 0;
+  size_t out_of_order_ = 0;
+  uint64_t next_count_ = 0;
+  LatencyHistogram latencies_;
+  std_msgs::msg::String summary_;
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr sub_;
+  rclcpp::Publisher<std_msgs::msg::String>::SharedPtr summary_pub_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
 };
 
 }  // namespace demo_nodes_cpp
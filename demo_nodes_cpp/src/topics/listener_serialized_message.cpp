@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <memory>
@@ -22,12 +23,13 @@
 
 #include "std_msgs/msg/string.hpp"
 
+#include "demo_nodes_cpp/serialized_message_pool.hpp"
 #include "demo_nodes_cpp/visibility_control.h"
 
+using namespace std::chrono_literals;
+
 namespace demo_nodes_cpp
 {
-// Create a Listener class that subclasses the generic rclcpp::Node base class.
-// The main function below will instantiate the class as a ROS node.
 class SerializedMessageListener : public rclcpp::Node
 {
 public:
@@ -36,39 +38,82 @@ public:
   : Node("serialized_message_listener", options)
   {
     setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+    // Whether to print every message and its serialized bytes.
+    hex_dump_ = this->declare_parameter("hex_dump", true);
+    auto pool = std::make_shared<SerializedMessagePool>(
+      static_cast<size_t>(this->declare_parameter("pool_size", 4)), 128u);
+
     // We create a callback to a rmw_serialized_message_t here. This will pass a serialized
     // message to the callback. We can then further deserialize it and convert it into
     // a ros2 compliant message.
     auto callback =
-      [](const std::shared_ptr<rclcpp::SerializedMessage> msg) -> void
+      [this](const std::shared_ptr<rclcpp::SerializedMessage> msg) -> void
       {
-        // Print the serialized data message in HEX representation
-        // This output corresponds to what you would see in e.g. Wireshark
-        // when tracing the RTPS packets.
-        std::cout << "I heard data of length: " << msg->size() << std::endl;
-        for (size_t i = 0; i < msg->size(); ++i) {
-          printf("%02x ", msg->get_rcl_serialized_message().buffer[i]);
+        if (hex_dump_) {
+          // Print the serialized data message in HEX representation
+          // This output corresponds to what you would see in e.g. Wireshark
+          // when tracing the RTPS packets.
+          std::cout << "I heard data of length: " << msg->size() << std::endl;
+          for (size_t i = 0; i < msg->size(); ++i) {
+            printf("%02x ", msg->get_rcl_serialized_message().buffer[i]);
+          }
+          printf("\n");
         }
-        printf("\n");
 
-        // In order to deserialize the message we have to manually create a ROS 2
-        // message in which we want to convert the serialized data.
-        using MessageT = std_msgs::msg::String;
-        MessageT string_msg;
-        auto serializer = rclcpp::Serialization<MessageT>();
-        serializer.deserialize_message(msg.get(), &string_msg);
-        // Finally print the ROS 2 message data
-        std::cout << "serialized data after deserialization: " << string_msg.data << std::endl;
+        // In order to deserialize the message we need a ROS 2 message in which we want to
+        // convert the serialized data. Both the message and the serializer are kept from one
+        // callback to the next, so the string keeps its capacity.
+        auto start = std::chrono::steady_clock::now();
+        serializer_.deserialize_message(msg.get(), &string_msg_);
+        deserialize_time_ += std::chrono::steady_clock::now() - start;
+        received_bytes_ += msg->size();
+        ++received_;
+        if (hex_dump_) {
+          // Finally print the ROS 2 message data
+          std::cout << "serialized data after deserialization: " << string_msg_.data << std::endl;
+        }
       };
     // Create a subscription to the topic which can be matched with one or more compatible ROS
     // publishers.
     // Note that not all publishers on the same topic with the same type will be compatible:
     // they must have compatible Quality of Service policies.
-    sub_ = create_subscription<std_msgs::msg::String>("chatter", 10, callback);
+    // The serialized messages are taken into buffers from a pool instead of new ones.
+    sub_ = create_subscription<std_msgs::msg::String>(
+      "chatter", 10, callback, rclcpp::SubscriptionOptions(),
+      std::make_shared<PooledMessageMemoryStrategy<std_msgs::msg::String>>(pool));
+    report_timer_ = this->create_wall_timer(1s, [this]() {report();});
   }
 
 private:
+  /// Log the cost of deserialization over the last period.
+  void report()
+  {
+    // The period restarts even when it was idle, so that the next rate covers only its own.
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_report_).count();
+    last_report_ = now;
+    if (received_ == 0) {
+      return;
+    }
+    RCLCPP_INFO(
+      this->get_logger(), "Received %zu messages: deserialize %.0f ns/msg, %.3f MB/s",
+      received_,
+      std::chrono::duration<double, std::nano>(deserialize_time_).count() / received_,
+      received_bytes_ / seconds / 1e6);
+    received_ = 0;
+    received_bytes_ = 0;
+    deserialize_time_ = std::chrono::steady_clock::duration::zero();
+  }
+
+  bool hex_dump_ = true;
+  std_msgs::msg::String string_msg_;
+  rclcpp::Serialization<std_msgs::msg::String> serializer_;
+  size_t received_ = 0;
+  size_t received_bytes_ = 0;
+  std::chrono::steady_clock::duration deserialize_time_{0};
+  std::chrono::steady_clock::time_point last_report_ = std::chrono::steady_clock::now();
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr sub_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
 };
 
 }  // namespace demo_nodes_cpp
@@ -0,0 +1,157 @@
+// Copyright 2019 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "bounded_msgs/msg/bounded_string.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "std_msgs/msg/float64.hpp"
+#include "std_msgs/msg/string.hpp"
+
+#include "demo_nodes_cpp/bounded_message.hpp"
+#include "demo_nodes_cpp/latency_histogram.hpp"
+
+// Compares the cost of publishing a POD message, a bounded string and an unbounded string
+// through borrow_loaned_message(). The bounded string is published twice: through the plain
+// loan API, which allocates a message whenever the middleware can't loan, and through
+// LoanOrPoolPublisher, which falls back to a preallocated message instead.
+// A subscription on each topic keeps the middleware doing the work of a matched publisher.
+
+using demo_nodes_cpp::LatencyHistogram;
+using demo_nodes_cpp::LoanOrPoolPublisher;
+
+// Time count calls of publish_one, spinning after every hundred so the subscription keeps up.
+void run(
+  const char * name, bool loaned, size_t count,
+  rclcpp::executors::SingleThreadedExecutor & executor,
+  const std::function<void(size_t)> & publish_one)
+{
+  LatencyHistogram latencies;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count && rclcpp::ok(); ++i) {
+    auto before = std::chrono::steady_clock::now();
+    publish_one(i);
+    latencies.record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - before).count());
+    if (i % 100 == 99) {
+      executor.spin_some();
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf(
+    "%-16s  %-6s  %10.0f  %8" PRIu64 "  %8" PRIu64 "  %8" PRIu64 "\n", name,
+    loaned ? "yes" : "no", latencies.count() / seconds,
+    latencies.percentile(0.5), latencies.percentile(0.99), latencies.max());
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h            Print this help message.\n");
+  printf("  --count N     Messages to publish of each kind. Defaults to 100000.\n");
+  printf("  --size N      Characters in each string, at most 256. Defaults to 64.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  size_t count = 100000;
+  size_t size = 64;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--count")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--count");
+      count = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--size")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--size");
+      size = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (count == 0 || size > bounded_msgs::msg::BoundedString().data.size()) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  auto node = rclcpp::Node::make_shared("loaned_message_benchmark");
+  rclcpp::QoS qos(rclcpp::KeepLast(100));
+  auto pod_pub = node->create_publisher<std_msgs::msg::Float64>("benchmark_pod", qos);
+  auto bounded_pub =
+    node->create_publisher<bounded_msgs::msg::BoundedString>("benchmark_bounded", qos);
+  auto unbounded_pub = node->create_publisher<std_msgs::msg::String>("benchmark_unbounded", qos);
+  LoanOrPoolPublisher<bounded_msgs::msg::BoundedString> pooled_pub(bounded_pub);
+
+  auto pod_sub = node->create_subscription<std_msgs::msg::Float64>(
+    "benchmark_pod", qos, [](std_msgs::msg::Float64::ConstSharedPtr) {});
+  auto bounded_sub = node->create_subscription<bounded_msgs::msg::BoundedString>(
+    "benchmark_bounded", qos, [](bounded_msgs::msg::BoundedString::ConstSharedPtr) {});
+  auto unbounded_sub = node->create_subscription<std_msgs::msg::String>(
+    "benchmark_unbounded", qos, [](std_msgs::msg::String::ConstSharedPtr) {});
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  const std::string text(size, 'x');
+
+  printf("publisher         loaned     msgs/s    p50 ns    p99 ns    max ns\n");
+  run(
+    "pod", pod_pub->can_loan_messages(), count, executor, [&pod_pub](size_t i) {
+      auto msg = pod_pub->borrow_loaned_message();
+      msg.get().data = static_cast<double>(i);
+      pod_pub->publish(std::move(msg));
+    });
+  run(
+    "bounded", bounded_pub->can_loan_messages(), count, executor,
+    [&bounded_pub, &text](size_t) {
+      auto msg = bounded_pub->borrow_loaned_message();
+      demo_nodes_cpp::assign(msg.get(), text);
+      bounded_pub->publish(std::move(msg));
+    });
+  run(
+    "bounded+pool", pooled_pub.loaning(), count, executor, [&pooled_pub, &text](size_t) {
+      pooled_pub.publish(
+        [&text](bounded_msgs::msg::BoundedString & msg) {
+          demo_nodes_cpp::assign(msg, text);
+        });
+    });
+  run(
+    "unbounded", unbounded_pub->can_loan_messages(), count, executor,
+    [&unbounded_pub, &text](size_t) {
+      auto msg = unbounded_pub->borrow_loaned_message();
+      msg.get().data = text;
+      unbounded_pub->publish(std::move(msg));
+    });
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -0,0 +1,312 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "demo_nodes_cpp/latency_histogram.hpp"
+#include "demo_nodes_cpp/memory_resources.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/allocator/allocator_common.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "std_msgs/msg/u_int32.hpp"
+
+// Compares memory resources for the allocations rclcpp makes per message.
+// For each resource, a publisher and a subscription exchange messages at a fixed rate, like in
+// the allocator tutorial, with the messages allocated from the resource through a polymorphic
+// allocator. Every allocation is timed,
+// and the bytes rclcpp holds are compared with what the resource took from the system, which
+// shows how much memory a resource keeps around for the same load.
+
+using demo_nodes_cpp::CallbackArenaResource;
+using demo_nodes_cpp::FixedPoolResource;
+using demo_nodes_cpp::LatencyHistogram;
+using demo_nodes_cpp::SlabResource;
+
+// The system end of every resource: malloc, counting what it really hands out.
+class SystemResource final : public std::pmr::memory_resource
+{
+public:
+  size_t peak() const
+  {
+    return peak_;
+  }
+
+private:
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    void * p = alignment <= alignof(std::max_align_t) ?
+      std::malloc(bytes) :
+      std::aligned_alloc(alignment, demo_nodes_cpp::align_up(bytes, alignment));
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+    in_use_ += usable_size(p, bytes);
+    peak_ = std::max(peak_, in_use_);
+    return p;
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t) override
+  {
+    in_use_ -= usable_size(p, bytes);
+    std::free(p);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  static size_t usable_size(void * p, size_t bytes)
+  {
+#ifdef __GLIBC__
+    (void)bytes;
+    return malloc_usable_size(p);
+#else
+    (void)p;
+    return bytes;
+#endif
+  }
+
+  size_t in_use_ = 0;
+  size_t peak_ = 0;
+};
+
+// Sits between rclcpp and the resource under test, timing every allocation.
+class MeasuringResource final : public std::pmr::memory_resource
+{
+public:
+  explicit MeasuringResource(std::pmr::memory_resource * measured)
+  : measured_(measured)
+  {
+  }
+
+  /// The latency of every allocation, kept without allocating itself.
+  LatencyHistogram latencies;
+  size_t allocations = 0;
+  size_t live = 0;
+  size_t peak_live = 0;
+
+private:
+  void * do_allocate(size_t bytes, size_t alignment) override
+  {
+    auto start = std::chrono::steady_clock::now();
+    void * p = measured_->allocate(bytes, alignment);
+    latencies.record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    ++allocations;
+    live += bytes;
+    peak_live = std::max(peak_live, live);
+    return p;
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    live -= bytes;
+    measured_->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource * measured_;
+};
+
+// Exchange messages allocated from the resource at the given rate for the given time.
+// after_spin runs after every spin of the executor, e.g. to rewind an arena.
+void run(
+  const char * name, std::pmr::memory_resource * resource, const SystemResource & system,
+  const std::function<void()> & after_spin, double rate, std::chrono::duration<double> duration)
+{
+  using Alloc = std::pmr::polymorphic_allocator<void>;
+  using MessageAllocTraits =
+    rclcpp::allocator::AllocRebind<std_msgs::msg::UInt32, Alloc>;
+  using MessageAlloc = MessageAllocTraits::allocator_type;
+  using MessageDeleter = rclcpp::allocator::Deleter<MessageAlloc, std_msgs::msg::UInt32>;
+  using MessageUniquePtr = std::unique_ptr<std_msgs::msg::UInt32, MessageDeleter>;
+
+  MeasuringResource measuring(resource);
+  auto alloc = std::make_shared<Alloc>(&measuring);
+  // The allocator of the publisher and subscription options is also handed to rcl, which keeps
+  // the publisher and subscription in it for as long as they exist and frees with a size of 1.
+  // So only the messages, allocated here and by the MessageMemoryStrategy, use the resource.
+  auto options_alloc = std::make_shared<Alloc>(std::pmr::new_delete_resource());
+  auto node = rclcpp::Node::make_shared("memory_resource_benchmark");
+
+  rclcpp::PublisherOptionsWithAllocator<Alloc> publisher_options;
+  publisher_options.allocator = options_alloc;
+  auto publisher = node->create_publisher<std_msgs::msg::UInt32>(
+    "memory_resource_benchmark", 10, publisher_options);
+
+  size_t received = 0;
+  rclcpp::SubscriptionOptionsWithAllocator<Alloc> subscription_options;
+  subscription_options.allocator = options_alloc;
+  auto msg_mem_strat = std::make_shared<
+    rclcpp::message_memory_strategy::MessageMemoryStrategy<
+      std_msgs::msg::UInt32, Alloc>>(alloc);
+  auto subscriber = node->create_subscription<std_msgs::msg::UInt32>(
+    "memory_resource_benchmark", 10,
+    [&received](std_msgs::msg::UInt32::ConstSharedPtr) {++received;},
+    subscription_options, msg_mem_strat);
+
+  // The executor keeps the default memory strategy: its handle lists live as long as the
+  // executor, which is not the per-message load this compares.
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  MessageDeleter message_deleter;
+  MessageAlloc message_alloc = *alloc;
+  rclcpp::allocator::set_allocator_for_deleter(&message_deleter, &message_alloc);
+
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / rate));
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+  auto next = start;
+  uint32_t published = 0;
+  while (next < end && rclcpp::ok()) {
+    auto ptr = MessageAllocTraits::allocate(message_alloc, 1);
+    MessageAllocTraits::construct(message_alloc, ptr);
+    MessageUniquePtr msg(ptr, message_deleter);
+    msg->data = published++;
+    publisher->publish(std::move(msg));
+    executor.spin_some();
+    after_spin();
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  size_t reserved = system.peak();
+  printf(
+    "%-12s  %9.0f  %9zu  %9zu  %8" PRIu64 "  %8" PRIu64 "  %8" PRIu64 "  %9.1f  %9.1f  %7.1f%%\n",
+    name, published / seconds, received, measuring.allocations,
+    measuring.latencies.percentile(0.5), measuring.latencies.percentile(0.99),
+    measuring.latencies.max(), measuring.peak_live / 1024.0, reserved / 1024.0,
+    reserved > 0 ? 100.0 * (1.0 - static_cast<double>(measuring.peak_live) / reserved) : 0.0);
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h               Print this help message.\n");
+  printf("  --rate HZ        Messages to publish per second. Defaults to 10000.\n");
+  printf("  --duration S     Seconds to run each resource for. Defaults to 2.\n");
+  printf(
+    "  --resource NAME  Only run one of malloc, std_pool, fixed_pool, slab and arena.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  double rate = 10000.0;
+  double duration = 2.0;
+  std::string only;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--rate")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--rate");
+      rate = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--resource")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--resource");
+      only = value ? value : "";
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (rate <= 0.0 || duration <= 0.0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  printf(
+    "resource       rate Hz   received     allocs    p50 ns    p99 ns    max ns   "
+    "live KiB  rsvd KiB  overhead\n");
+  auto selected = [&only](const char * name) {return only.empty() || only == name;};
+  auto nothing = []() {};
+  std::chrono::duration<double> seconds(duration);
+  if (selected("malloc")) {
+    SystemResource system;
+    run("malloc", &system, system, nothing, rate, seconds);
+  }
+  if (selected("std_pool")) {
+    SystemResource system;
+    std::pmr::unsynchronized_pool_resource pool(&system);
+    run("std_pool", &pool, system, nothing, rate, seconds);
+  }
+  size_t fallbacks = 0;
+  if (selected("fixed_pool")) {
+    SystemResource system;
+    FixedPoolResource pool(256, 1024, &system);
+    run("fixed_pool", &pool, system, nothing, rate, seconds);
+    fallbacks = pool.fallbacks();
+  }
+  if (selected("slab")) {
+    SystemResource system;
+    SlabResource slab(64 * 1024, 4096, &system);
+    run("slab", &slab, system, nothing, rate, seconds);
+  }
+  size_t resets = 0;
+  size_t deferred = 0;
+  if (selected("arena")) {
+    SystemResource system;
+    CallbackArenaResource arena(64 * 1024, &system);
+    run(
+      "arena", &arena, system, [&arena, &resets]() {
+        arena.reset();
+        ++resets;
+      }, rate, seconds);
+    deferred = arena.deferred_resets();
+  }
+  if (selected("fixed_pool")) {
+    printf("fixed_pool: %zu allocations fell back to malloc\n", fallbacks);
+  }
+  if (selected("arena")) {
+    printf(
+      "arena: %zu of %zu resets were deferred by allocations still in use\n", deferred, resets);
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
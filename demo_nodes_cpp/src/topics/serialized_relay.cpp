@@ -0,0 +1,182 @@
+// Copyright 2017 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp_components/register_node_macro.hpp"
+
+#include "demo_nodes_cpp/visibility_control.h"
+
+using namespace std::chrono_literals;
+
+namespace demo_nodes_cpp
+{
+// Relays one topic of any type to one or more other topics without ever deserializing it.
+// The subscription hands over the serialized (CDR) message the middleware received, and the
+// same buffer is published on every output topic, so forwarding a message costs what it takes
+// the middleware to copy those bytes instead of a deserialize and serialize of the whole type.
+// The relay starts once a publisher of the input topic shows up, and subscribes and publishes
+// with the QoS the input's publishers offer, so that e.g. best effort or transient local data is
+// relayed as such.
+class SerializedRelay : public rclcpp::Node
+{
+public:
+  DEMO_NODES_CPP_PUBLIC
+  explicit SerializedRelay(const rclcpp::NodeOptions & options)
+  : Node("serialized_relay", options)
+  {
+    input_topic_ = this->declare_parameter("input_topic", std::string("chatter"));
+    output_topics_ = this->declare_parameter(
+      "output_topics", std::vector<std::string>{"chatter_relay"});
+    // The type of the topic, e.g. "std_msgs/msg/String". If it is left empty, the relay takes
+    // the type of the first publisher of the input topic.
+    type_ = this->declare_parameter("type", std::string());
+    // Forward at most this many messages a second, dropping the ones in between. 0 forwards all.
+    double max_rate = this->declare_parameter("max_rate", 0.0);
+    if (max_rate > 0.0) {
+      min_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / max_rate));
+    }
+    if (output_topics_.empty()) {
+      throw std::invalid_argument("output_topics must name at least one topic");
+    }
+    // Relaying a topic onto itself would forward every message again forever.
+    auto topics = this->get_node_topics_interface();
+    const std::string input = topics->resolve_topic_name(input_topic_);
+    for (const auto & topic : output_topics_) {
+      if (topics->resolve_topic_name(topic) == input) {
+        throw std::invalid_argument("output topic '" + topic + "' is the input topic");
+      }
+    }
+
+    discovery_timer_ = this->create_wall_timer(500ms, [this]() {discover();});
+    report_timer_ = this->create_wall_timer(1s, [this]() {report();});
+  }
+
+private:
+  /// Look the publishers of the input topic up in the graph, and start relaying once there is
+  /// one, with the type and QoS they publish with.
+  void discover()
+  {
+    auto endpoints = this->get_publishers_info_by_topic(input_topic_);
+    if (endpoints.empty()) {
+      RCLCPP_INFO_ONCE(
+        this->get_logger(), "Waiting for a publisher on '%s'", input_topic_.c_str());
+      return;
+    }
+    std::string type = type_.empty() ? endpoints.front().topic_type() : type_;
+    // Subscribe with what every publisher offers, so that none of them is incompatible.
+    rclcpp::QoS qos(10);
+    bool transient_local = true;
+    size_t matching = 0;
+    for (const auto & endpoint : endpoints) {
+      if (endpoint.topic_type() != type) {
+        RCLCPP_WARN_ONCE(
+          this->get_logger(), "'%s' is published with several types, relaying '%s'",
+          input_topic_.c_str(), type.c_str());
+        continue;
+      }
+      ++matching;
+      const rclcpp::QoS & offered = endpoint.qos_profile();
+      if (offered.reliability() == rclcpp::ReliabilityPolicy::BestEffort) {
+        qos.best_effort();
+      }
+      if (offered.durability() != rclcpp::DurabilityPolicy::TransientLocal) {
+        transient_local = false;
+      }
+    }
+    if (matching == 0) {
+      RCLCPP_INFO_ONCE(
+        this->get_logger(), "Waiting for a publisher of '%s' on '%s'", type.c_str(),
+        input_topic_.c_str());
+      return;
+    }
+    if (transient_local) {
+      qos.transient_local();
+    }
+    type_ = type;
+    discovery_timer_->cancel();
+    start(qos);
+  }
+
+  void start(const rclcpp::QoS & qos)
+  {
+    for (const auto & topic : output_topics_) {
+      publishers_.push_back(this->create_generic_publisher(topic, type_, qos));
+    }
+    sub_ = this->create_generic_subscription(
+      input_topic_, type_, qos,
+      [this](std::shared_ptr<const rclcpp::SerializedMessage> msg) {relay(*msg);});
+    RCLCPP_INFO(
+      this->get_logger(), "Relaying '%s' [%s] to %zu topic(s), %s and %s", input_topic_.c_str(),
+      type_.c_str(), publishers_.size(),
+      qos.reliability() == rclcpp::ReliabilityPolicy::BestEffort ? "best effort" : "reliable",
+      qos.durability() == rclcpp::DurabilityPolicy::TransientLocal ?
+      "transient local" : "volatile");
+  }
+
+  void relay(const rclcpp::SerializedMessage & msg)
+  {
+    ++received_;
+    if (min_period_ > std::chrono::steady_clock::duration::zero()) {
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_forwarded_ < min_period_) {
+        return;
+      }
+      last_forwarded_ = now;
+    }
+    // Every output publishes the very buffer the subscription received.
+    for (const auto & publisher : publishers_) {
+      publisher->publish(msg);
+    }
+    ++forwarded_;
+    forwarded_bytes_ += msg.size();
+  }
+
+  /// Log how many messages were relayed over the last period.
+  void report()
+  {
+    if (received_ == 0) {
+      return;
+    }
+    RCLCPP_INFO(
+      this->get_logger(), "Forwarded %zu of %zu messages (%zu bytes) to %zu topic(s)",
+      forwarded_, received_, forwarded_bytes_, publishers_.size());
+    received_ = 0;
+    forwarded_ = 0;
+    forwarded_bytes_ = 0;
+  }
+
+  std::string input_topic_;
+  std::vector<std::string> output_topics_;
+  std::string type_;
+  std::chrono::steady_clock::duration min_period_{0};
+  std::chrono::steady_clock::time_point last_forwarded_;
+  size_t received_ = 0;
+  size_t forwarded_ = 0;
+  size_t forwarded_bytes_ = 0;
+  std::vector<rclcpp::GenericPublisher::SharedPtr> publishers_;
+  rclcpp::GenericSubscription::SharedPtr sub_;
+  rclcpp::TimerBase::SharedPtr discovery_timer_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
+};
+
+}  // namespace demo_nodes_cpp
+
+RCLCPP_COMPONENTS_REGISTER_NODE(demo_nodes_cpp::SerializedRelay)
@@ -15,7 +15,7 @@
 #include <chrono>
 #include <cstdio>
 #include <memory>
-#include <utility>
+#include <string>
 
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
@@ -37,17 +37,51 @@ public:
   explicit Talker(const rclcpp::NodeOptions & options)
   : Node("talker", options)
   {
+    // How often to publish, 0 to publish as fast as possible.
+    int64_t publish_ms = this->declare_parameter("publish_ms", 1000);
+    // How many messages to publish each time.
+    burst_ = static_cast<size_t>(this->declare_parameter("burst", 1));
+    // How many messages to publish before stopping, 0 to never stop.
+    limit_ = static_cast<size_t>(this->declare_parameter("count", 0));
+    // Pad the messages to this many bytes.
+    payload_bytes_ = static_cast<size_t>(this->declare_parameter("payload_bytes", 0));
+    // Probe the latency: add the time of publishing to each message, from the monotonic clock
+    // which all processes on the host share, so a listener can tell how long it took.
+    probe_ = this->declare_parameter("probe", false);
+    // Log every message, or else how many were published each second.
+    log_messages_ = this->declare_parameter("log_messages", true);
+
     // Create a function for when messages are to be sent.
     setvbuf(stdout, NULL, _IONBF, BUFSIZ);
     auto publish_message =
       [this]() -> void
       {
-        msg_ = std::make_unique<std_msgs::msg::String>();
-        msg_->data = "Hello World: " + std::to_string(count_++);
-        RCLCPP_INFO(this->get_logger(), "Publishing: '%s'", msg_->data.c_str());
-        // Put the message into a queue to be processed by the middleware.
-        // This call is non-blocking.
-        pub_->publish(std::move(msg_));
+        for (size_t i = 0; i < burst_; ++i) {
+          if (limit_ > 0 && count_ > limit_) {
+            RCLCPP_INFO(this->get_logger(), "Published %zu messages", limit_);
+            timer_->cancel();
+            return;
+          }
+          // The message is reused, so its string keeps the capacity it grew to.
+          msg_.data = "Hello World: ";
+          msg_.data += std::to_string(count_++);
+          if (probe_) {
+            msg_.data += " t=";
+            msg_.data += std::to_string(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+          }
+          if (msg_.data.size() < payload_bytes_) {
+            msg_.data.resize(payload_bytes_, ' ');
+          }
+          if (log_messages_) {
+            RCLCPP_INFO(this->get_logger(), "Publishing: '%s'", msg_.data.c_str());
+          }
+          // Put the message into a queue to be processed by the middleware.
+          // This call is non-blocking.
+          pub_->publish(msg_);
+          ++published_;
+        }
       };
     // Create a publisher with a custom Quality of Service profile.
     // Uniform initialization is suggested so it can be trivially changed to
@@ -57,14 +91,30 @@ public:
     pub_ = this->create_publisher<std_msgs::msg::String>("chatter", qos);
 
     // Use a timer to schedule periodic message publishing.
-    timer_ = this->create_wall_timer(1s, publish_message);
+    timer_ = this->create_wall_timer(std::chrono::milliseconds(publish_ms), publish_message);
+    if (!log_messages_) {
+      report_timer_ = this->create_wall_timer(
+        1s, [this]() {
+          if (published_ > 0) {
+            RCLCPP_INFO(this->get_logger(), "Published %zu messages/s", published_);
+            published_ = 0;
+          }
+        });
+    }
   }
 
 private:
   size_t count_ = 1;
-  std::unique_ptr<std_msgs::msg::String> msg_;
+  size_t burst_ = 1;
+  size_t limit_ = 0;
+  size_t payload_bytes_ = 0;
+  bool probe_ = false;
+  bool log_messages_ = true;
+  size_t published_ = 0;
+  std_msgs::msg::String msg_;
   rclcpp::Publisher<std_msgs::msg::String>::SharedPtr pub_;
   rclcpp::TimerBase::SharedPtr timer_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
 };
 
 }  // namespace demo_nodes_cpp
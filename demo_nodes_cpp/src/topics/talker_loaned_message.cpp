@@ -20,9 +20,11 @@
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
 
+#include "bounded_msgs/msg/bounded_string.hpp"
 #include "std_msgs/msg/float64.hpp"
 #include "std_msgs/msg/string.hpp"
 
+#include "demo_nodes_cpp/bounded_message.hpp"
 #include "demo_nodes_cpp/visibility_control.h"
 
 using namespace std::chrono_literals;
@@ -80,6 +82,17 @@ public:
         non_pod_loaned_msg.get().data = non_pod_msg_data;
         RCLCPP_INFO(this->get_logger(), "Publishing: '%s'", non_pod_msg_data.c_str());
         non_pod_pub_->publish(std::move(non_pod_loaned_msg));
+
+        // A bounded string keeps its characters in a fixed-size array, so the message is a POD
+        // again and can be loaned like the Float64 above. If the middleware can't loan it,
+        // the message comes from a pool allocated up front instead of the heap.
+        bounded_pub_->publish(
+          [&non_pod_msg_data](bounded_msgs::msg::BoundedString & msg) {
+            assign(msg, non_pod_msg_data);
+          });
+        RCLCPP_INFO(
+          this->get_logger(), "Publishing: '%s' (bounded, %s)", non_pod_msg_data.c_str(),
+          bounded_pub_->loaning() ? "loaned" : "pooled");
         count_++;
       };
 
@@ -87,6 +100,8 @@ public:
     rclcpp::QoS qos(rclcpp::KeepLast(7));
     pod_pub_ = this->create_publisher<std_msgs::msg::Float64>("chatter_pod", qos);
     non_pod_pub_ = this->create_publisher<std_msgs::msg::String>("chatter", qos);
+    bounded_pub_ = std::make_unique<LoanOrPoolPublisher<bounded_msgs::msg::BoundedString>>(
+      this->create_publisher<bounded_msgs::msg::BoundedString>("chatter_bounded", qos));
 
     // Use a timer to schedule periodic message publishing.
     timer_ = this->create_wall_timer(1s, publish_message);
@@ -96,6 +111,7 @@ private:
   size_t count_ = 1;
   rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr pod_pub_;
   rclcpp::Publisher<std_msgs::msg::String>::SharedPtr non_pod_pub_;
+  std::unique_ptr<LoanOrPoolPublisher<bounded_msgs::msg::BoundedString>> bounded_pub_;
   rclcpp::TimerBase::SharedPtr timer_;
 };
 
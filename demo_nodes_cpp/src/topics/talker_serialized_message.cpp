@@ -13,8 +13,10 @@
 // limitations under the License.
 
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
@@ -23,6 +25,7 @@
 
 #include "rclcpp/serialization.hpp"
 
+#include "demo_nodes_cpp/serialized_message_pool.hpp"
 #include "demo_nodes_cpp/visibility_control.h"
 
 using namespace std::chrono_literals;
@@ -35,9 +38,19 @@ class SerializedMessageTalker : public rclcpp::Node
 public:
   DEMO_NODES_CPP_PUBLIC
   explicit SerializedMessageTalker(const rclcpp::NodeOptions & options)
-  : Node("serialized_message_talker", options),
-    serialized_msg_(0u)
+  : Node("serialized_message_talker", options)
   {
+    // How often to publish; 0 publishes as fast as the executor can.
+    int64_t publish_ms = this->declare_parameter("publish_ms", 1000);
+    // Whether to print every message and its serialized bytes.
+    hex_dump_ = this->declare_parameter("hex_dump", true);
+    // Pad the text of each message to this many characters, to publish larger messages.
+    payload_bytes_ = static_cast<size_t>(this->declare_parameter("payload_bytes", 0));
+    // The serialized data is composed of a 8 Byte header plus the length of the payload.
+    // Reserving that up front means no dynamic memory allocation has to be done down the stack.
+    pool_ = std::make_shared<SerializedMessagePool>(
+      static_cast<size_t>(this->declare_parameter("pool_size", 4)), 8u + 64u + payload_bytes_);
+
     // Create a function for when messages are to be sent.
     auto publish_message =
       [this]() -> void
@@ -54,48 +67,80 @@ public:
 
         // In order to ease things up, we call the rmw_serialize function,
         // which can do the above conversion for us.
-        // For this, we initially fill up a std_msgs/String message and fill up its content
-        auto string_msg = std::make_shared<std_msgs::msg::String>();
-        string_msg->data = "Hello World:" + std::to_string(count_++);
-
-        // We know the size of the data to be sent, and thus can pre-allocate the
-        // necessary memory to hold all the data.
-        // This is specifically interesting to do here, because this means
-        // no dynamic memory allocation has to be done down the stack.
-        // If we don't allocate enough memory, the serialized message will be
-        // dynamically allocated before sending it to the wire.
-        auto message_header_length = 8u;
-        auto message_payload_length = static_cast<size_t>(string_msg->data.size());
-        serialized_msg_.reserve(message_header_length + message_payload_length);
-
-        static rclcpp::Serialization<std_msgs::msg::String> serializer;
-        serializer.serialize_message(string_msg.get(), &serialized_msg_);
-
-        // For demonstration we print the ROS 2 message format
-        printf("ROS message:\n");
-        printf("%s\n", string_msg->data.c_str());
-        // And after the corresponding binary representation
-        printf("serialized message:\n");
-        for (size_t i = 0; i < serialized_msg_.size(); ++i) {
-          printf("%02x ", serialized_msg_.get_rcl_serialized_message().buffer[i]);
+        // For this, we fill up a std_msgs/String message, which is reused along with the
+        // capacity of its string from one message to the next.
+        string_msg_.data.assign("Hello World:");
+        string_msg_.data += std::to_string(count_++);
+        if (string_msg_.data.size() < payload_bytes_) {
+          string_msg_.data.resize(payload_bytes_, ' ');
+        }
+
+        // The buffer comes from a pool, which grows a buffer if the message does not fit.
+        auto serialized_msg = pool_->acquire(8u + string_msg_.data.size());
+        auto start = std::chrono::steady_clock::now();
+        serializer_.serialize_message(&string_msg_, serialized_msg.get());
+        serialize_time_ += std::chrono::steady_clock::now() - start;
+        serialized_bytes_ += serialized_msg->size();
+        ++published_;
+
+        if (hex_dump_) {
+          // For demonstration we print the ROS 2 message format
+          printf("ROS message:\n");
+          printf("%s\n", string_msg_.data.c_str());
+          // And after the corresponding binary representation
+          printf("serialized message:\n");
+          for (size_t i = 0; i < serialized_msg->size(); ++i) {
+            printf("%02x ", serialized_msg->get_rcl_serialized_message().buffer[i]);
+          }
+          printf("\n");
         }
-        printf("\n");
 
-        pub_->publish(serialized_msg_);
+        pub_->publish(*serialized_msg);
+        pool_->release(serialized_msg);
       };
 
     rclcpp::QoS qos(rclcpp::KeepLast(7));
     pub_ = this->create_publisher<std_msgs::msg::String>("chatter", qos);
 
     // Use a timer to schedule periodic message publishing.
-    timer_ = this->create_wall_timer(1s, publish_message);
+    timer_ = this->create_wall_timer(std::chrono::milliseconds(publish_ms), publish_message);
+    report_timer_ = this->create_wall_timer(1s, [this]() {report();});
   }
 
 private:
+  /// Log the cost of serialization over the last period.
+  void report()
+  {
+    // An idle period ends here too, or the next rate would be spread over it.
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_report_).count();
+    last_report_ = now;
+    if (published_ == 0) {
+      return;
+    }
+    RCLCPP_INFO(
+      this->get_logger(), "Published %zu messages: serialize %.0f ns/msg, %.3f MB/s",
+      published_,
+      std::chrono::duration<double, std::nano>(serialize_time_).count() / published_,
+      serialized_bytes_ / seconds / 1e6);
+    published_ = 0;
+    serialized_bytes_ = 0;
+    serialize_time_ = std::chrono::steady_clock::duration::zero();
+  }
+
   size_t count_ = 1;
-  rclcpp::SerializedMessage serialized_msg_;
+  bool hex_dump_ = true;
+  size_t payload_bytes_ = 0;
+  std_msgs::msg::String string_msg_;
+  rclcpp::Serialization<std_msgs::msg::String> serializer_;
+  std::shared_ptr<SerializedMessagePool> pool_;
+  size_t published_ = 0;
+  size_t serialized_bytes_ = 0;
+  std::chrono::steady_clock::duration serialize_time_{0};
+  std::chrono::steady_clock::time_point last_report_ = std::chrono::steady_clock::now();
   rclcpp::Publisher<std_msgs::msg::String>::SharedPtr pub_;
   rclcpp::TimerBase::SharedPtr timer_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
 };
 
 }  // namespace demo_nodes_cpp
@@ -15,7 +15,10 @@
 #ifndef IMAGE_PIPELINE__CAMERA_NODE_HPP_
 #define IMAGE_PIPELINE__CAMERA_NODE_HPP_
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -26,6 +29,34 @@
 #include "sensor_msgs/msg/image.hpp"
 
 #include "common.hpp"
+#include "frame_pool.hpp"
+#include "latency_tracer.hpp"
+
+/// Where a CameraNode takes its frames from.
+struct CameraSource
+{
+  enum class Kind
+  {
+    /// A camera device opened through OpenCV.
+    Device,
+    /// A video file, which is played in a loop.
+    File,
+    /// A synthetic moving test pattern, which needs no hardware at all.
+    Pattern,
+  };
+
+  Kind kind = Kind::Device;
+  /// Which camera device to use.
+  int device = 0;
+  /// Which video file to play.
+  std::string file;
+  /// What video width to capture at.
+  int width = 320;
+  /// What video height to capture at.
+  int height = 240;
+  /// How many frames per second to publish at most, 0 publishes as fast as the source allows.
+  double rate = 0.0;
+};
 
 /// Node which captures images from a camera using OpenCV and publishes them.
 /// Images are annotated with this process's id as well as the message's ptr.
@@ -36,24 +67,37 @@ public:
   /// \param output The output topic name to use
   /// \param node_name The node name to use
   /// \param watermark Whether to add a watermark to the image before publishing
-  /// \param device Which camera device to use
-  /// \param width What video width to capture at
-  /// \param height What video height to capture at
+  /// \param source Where to take the frames from and at which resolution and rate
+  /// \param pool Optional pool to take messages from, frames are then captured in place
+  /// \param tracer Optional tracer to record the capture time of each frame into
   explicit CameraNode(
     const std::string & output, const std::string & node_name = "camera_node",
-    bool watermark = true, int device = 0, int width = 320, int height = 240)
+    bool watermark = true, const CameraSource & source = CameraSource(),
+    std::shared_ptr<FramePool> pool = nullptr, std::shared_ptr<LatencyTracer> tracer = nullptr)
   : Node(node_name, rclcpp::NodeOptions().use_intra_process_comms(true)),
-    canceled_(false), watermark_(watermark)
+    canceled_(false), watermark_(watermark), source_(source), pool_(std::move(pool)),
+    tracer_(std::move(tracer))
   {
-    // Initialize OpenCV
-    cap_.open(device);
-    cap_.set(cv::CAP_PROP_FRAME_WIDTH, static_cast<double>(width));
-    cap_.set(cv::CAP_PROP_FRAME_HEIGHT, static_cast<double>(height));
-    if (!cap_.isOpened()) {
-      throw std::runtime_error("Could not open video stream!");
+    if (source_.kind == CameraSource::Kind::Pattern) {
+      make_pattern();
+    } else {
+      // Initialize OpenCV
+      if (source_.kind == CameraSource::Kind::File) {
+        cap_.open(source_.file);
+      } else {
+        cap_.open(source_.device);
+        cap_.set(cv::CAP_PROP_FRAME_WIDTH, static_cast<double>(source_.width));
+        cap_.set(cv::CAP_PROP_FRAME_HEIGHT, static_cast<double>(source_.height));
+      }
+      if (!cap_.isOpened()) {
+        throw std::runtime_error("Could not open video stream!");
+      }
     }
     // Create a publisher on the output topic.
     pub_ = this->create_publisher<sensor_msgs::msg::Image>(output, rclcpp::SensorDataQoS());
+    if (tracer_) {
+      stage_ = tracer_->add_stage(node_name);
+    }
     // Create the camera reading loop.
     thread_ = std::thread([this]() {return this->loop();});
   }
@@ -70,13 +114,19 @@ public:
   /// \brief Capture and publish data until the program is closed
   void loop()
   {
+    if (pool_) {
+      return pooled_loop();
+    }
     // While running...
     while (rclcpp::ok() && !canceled_.load()) {
+      throttle();
+      int64_t capture_start = LatencyTracer::now();
       // Capture a frame from OpenCV.
-      cap_ >> frame_;
+      grab(frame_);
       if (frame_.empty()) {
         continue;
       }
+      int64_t capture_done = LatencyTracer::now();
       // Create a new unique_ptr to an Image message for storage.
       sensor_msgs::msg::Image::UniquePtr msg(new sensor_msgs::msg::Image());
 
@@ -95,11 +145,148 @@ public:
       msg->is_bigendian = false;
       msg->step = static_cast<sensor_msgs::msg::Image::_step_type>(frame_.step);
       msg->data.assign(frame_.datastart, frame_.dataend);
-      pub_->publish(std::move(msg));  // Publish.
+      publish(std::move(msg), capture_start, capture_done);
+    }
+  }
+
+  /// \brief Capture straight into messages recycled through the pool and publish them
+  void pooled_loop()
+  {
+    while (rclcpp::ok() && !canceled_.load()) {
+      throttle();
+      int64_t capture_start = LatencyTracer::now();
+      sensor_msgs::msg::Image::UniquePtr msg = pool_->acquire();
+      bool in_place = false;
+      if (!frame_.empty()) {
+        // Once the frame geometry is known, let OpenCV decode directly into the pooled storage.
+        // A recycled message already has the right size, so resize() neither allocates nor fills.
+        msg->data.resize(frame_.step * frame_.rows);
+        cv::Mat pooled(frame_.rows, frame_.cols, frame_.type(), msg->data.data(), frame_.step);
+        grab(pooled);
+        if (pooled.empty()) {
+          pool_->release(std::move(msg));
+          continue;
+        }
+        in_place = pooled.data == msg->data.data();
+        if (!in_place) {
+          // The geometry changed and OpenCV reallocated, so copy this frame and adapt.
+          frame_ = pooled;
+        }
+      } else {
+        grab(frame_);
+        if (frame_.empty()) {
+          pool_->release(std::move(msg));
+          continue;
+        }
+      }
+      if (!in_place) {
+        msg->data.assign(frame_.datastart, frame_.dataend);
+        pool_->count_copy();
+      }
+      int64_t capture_done = LatencyTracer::now();
+      cv::Mat cv_mat(frame_.rows, frame_.cols, frame_.type(), msg->data.data(), frame_.step);
+      if (watermark_) {
+        std::stringstream ss;
+        ss << "pid: " << GETPID() << ", ptr: " << msg.get();
+        draw_on_image(cv_mat, ss.str(), 20);
+      }
+      set_now(msg->header.stamp);
+      msg->header.frame_id = "camera_frame";
+      msg->height = frame_.rows;
+      msg->width = frame_.cols;
+      msg->encoding = mat_type2encoding(frame_.type());
+      msg->is_bigendian = false;
+      msg->step = static_cast<sensor_msgs::msg::Image::_step_type>(frame_.step);
+      publish(std::move(msg), capture_start, capture_done);
     }
   }
 
 private:
+  /// \brief Draw the background of the test pattern, a gradient over the whole frame
+  void make_pattern()
+  {
+    pattern_ = cv::Mat(source_.height, source_.width, CV_8UC3);
+    for (int row = 0; row < pattern_.rows; ++row) {
+      uint8_t * pixel = pattern_.ptr<uint8_t>(row);
+      for (int col = 0; col < pattern_.cols; ++col) {
+        *pixel++ = static_cast<uint8_t>(255 * col / pattern_.cols);
+        *pixel++ = static_cast<uint8_t>(255 * row / pattern_.rows);
+        *pixel++ = 128;
+      }
+    }
+  }
+
+  /// \brief Take the next frame from the source
+  /// \param frame Where to put the frame; its storage is reused if it has the right geometry
+  void grab(cv::Mat & frame)
+  {
+    switch (source_.kind) {
+      case CameraSource::Kind::Pattern:
+        {
+          // Copy the background and sweep a bar across it, so consecutive frames differ.
+          pattern_.copyTo(frame);
+          int width = std::max(1, pattern_.cols / 16);
+          int x = static_cast<int>(frame_count_ % static_cast<uint64_t>(pattern_.cols));
+          cv::rectangle(
+            frame, cv::Point(x, 0), cv::Point(x + width, pattern_.rows), cv::Scalar(255, 255, 255),
+            cv::FILLED);
+          break;
+        }
+      case CameraSource::Kind::File:
+        cap_ >> file_frame_;
+        if (file_frame_.empty()) {
+          // Rewind at the end of the file.
+          cap_.set(cv::CAP_PROP_POS_FRAMES, 0.0);
+          cap_ >> file_frame_;
+        }
+        if (file_frame_.empty()) {
+          frame = cv::Mat();
+        } else if (file_frame_.cols != source_.width || file_frame_.rows != source_.height) {
+          cv::resize(file_frame_, frame, cv::Size(source_.width, source_.height));
+        } else {
+          file_frame_.copyTo(frame);
+        }
+        break;
+      case CameraSource::Kind::Device:
+        cap_ >> frame;
+        break;
+    }
+    ++frame_count_;
+  }
+
+  /// \brief Wait until the next frame is due, if the source is rate limited
+  void throttle()
+  {
+    if (source_.rate <= 0.0) {
+      return;
+    }
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / source_.rate));
+    auto now = std::chrono::steady_clock::now();
+    if (next_frame_ > now) {
+      std::this_thread::sleep_until(next_frame_);
+      next_frame_ += period;
+    } else {
+      // Running late, do not try to catch up with a burst.
+      next_frame_ = now + period;
+    }
+  }
+
+  /// \brief Publish a frame, tracing it first if a tracer was given
+  void publish(
+    sensor_msgs::msg::Image::UniquePtr msg, int64_t capture_start, int64_t capture_done)
+  {
+    if (tracer_) {
+      const auto & stamp = msg->header.stamp;
+      tracer_->record(stamp, stage_, LatencyTracer::Event::Enqueue, capture_start);
+      tracer_->record(stamp, stage_, LatencyTracer::Event::Dequeue, capture_done);
+      int64_t now = LatencyTracer::now();
+      tracer_->published(stamp, pub_->get_topic_name(), now);
+      tracer_->record(stamp, stage_, LatencyTracer::Event::Done, now);
+    }
+    pub_->publish(std::move(msg));  // Publish.
+  }
+
   rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr pub_;
   std::thread thread_;
   std::atomic<bool> canceled_;
@@ -108,6 +295,21 @@ private:
   /// pointer location
   bool watermark_;
 
+  CameraSource source_;
+  /// background of the synthetic test pattern
+  cv::Mat pattern_;
+  /// frame read from a video file, before it is scaled to the configured resolution
+  cv::Mat file_frame_;
+  uint64_t frame_count_ = 0;
+  std::chrono::steady_clock::time_point next_frame_;
+
+  /// pool which published messages are taken from and returned to by the sink
+  std::shared_ptr<FramePool> pool_;
+
+  /// tracer to record the capture time of each frame into, and the stage to record it as
+  std::shared_ptr<LatencyTracer> tracer_;
+  size_t stage_ = 0;
+
   cv::VideoCapture cap_;
   cv::Mat frame_;
 };
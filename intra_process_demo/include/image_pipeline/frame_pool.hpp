@@ -0,0 +1,197 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__FRAME_POOL_HPP_
+#define IMAGE_PIPELINE__FRAME_POOL_HPP_
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include "sensor_msgs/msg/image.hpp"
+
+/// Lock-free pool of preallocated image messages which are recycled through a pipeline.
+/// The source acquires a message from the pool and the sink hands it back once it is done
+/// with it, so a pipeline in steady state does not allocate any frames.
+/// The free list is a bounded multi-producer/multi-consumer ring (Dmitry Vyukov's design),
+/// so several sinks may return frames while the source is acquiring them.
+class FramePool final
+{
+public:
+  using Image = sensor_msgs::msg::Image;
+
+  /// Counters describing what each stage of the pipeline did with its frames.
+  struct Stats
+  {
+    /// Frames taken from the pool by the source.
+    std::atomic<uint64_t> acquired{0};
+    /// Frames the source had to allocate because the pool was empty.
+    std::atomic<uint64_t> allocated{0};
+    /// Frames whose pixels could not be captured in place and had to be copied.
+    std::atomic<uint64_t> copied{0};
+    /// Frames handed back to the pool by a sink.
+    std::atomic<uint64_t> returned{0};
+    /// Frames freed by a sink because the pool was already full.
+    std::atomic<uint64_t> dropped{0};
+  };
+
+  /// \brief Construct a pool and fill it with preallocated messages
+  /// \param capacity How many messages to preallocate
+  /// \param frame_bytes How many bytes of pixel storage to reserve for each message
+  explicit FramePool(size_t capacity, size_t frame_bytes = 0)
+  {
+    // Leave slack in the ring, so a thread which is preempted in the middle of a push or pop
+    // does not make the pool look full to the others.
+    size_t size = 2;
+    while (size < 2 * capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+      Image * msg = new Image();
+      msg->data.reserve(frame_bytes);
+      push(msg);
+    }
+  }
+
+  FramePool(const FramePool &) = delete;
+  FramePool & operator=(const FramePool &) = delete;
+
+  ~FramePool()
+  {
+    Image * msg = nullptr;
+    while (pop(msg)) {
+      delete msg;
+    }
+  }
+
+  /// \brief Take a message out of the pool, allocating a new one only if the pool is empty
+  /// \return A message which may still hold the pixels of the frame it last carried
+  Image::UniquePtr acquire()
+  {
+    stats_.acquired.fetch_add(1, std::memory_order_relaxed);
+    Image * msg = nullptr;
+    if (pop(msg)) {
+      return Image::UniquePtr(msg);
+    }
+    stats_.allocated.fetch_add(1, std::memory_order_relaxed);
+    return Image::UniquePtr(new Image());
+  }
+
+  /// \brief Hand a message back to the pool so the source can fill it again
+  /// \param msg The message to recycle; it is freed if the pool is already full
+  void release(Image::UniquePtr msg)
+  {
+    if (!msg) {
+      return;
+    }
+    if (push(msg.get())) {
+      msg.release();
+      stats_.returned.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /// \brief Record that a frame had to be copied into its message
+  void count_copy()
+  {
+    stats_.copied.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const Stats & stats() const
+  {
+    return stats_;
+  }
+
+  /// \brief Print the per-stage counters to stdout
+  void print_stats() const
+  {
+    printf(
+      "camera: acquired %" PRIu64 ", allocated %" PRIu64 ", copied %" PRIu64 "\n",
+      stats_.acquired.load(), stats_.allocated.load(), stats_.copied.load());
+    printf(
+      "image_view: returned %" PRIu64 ", dropped %" PRIu64 "\n",
+      stats_.returned.load(), stats_.dropped.load());
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    Image * msg;
+  };
+
+  bool push(Image * msg)
+  {
+    Cell * cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // Full.
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->msg = msg;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(Image * & msg)
+  {
+    Cell * cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // Empty.
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    msg = cell->msg;
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  // Keep the producer and consumer indices on separate cache lines.
+  alignas(64) std::atomic<size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<size_t> dequeue_pos_{0};
+  Stats stats_;
+};
+
+#endif  // IMAGE_PIPELINE__FRAME_POOL_HPP_
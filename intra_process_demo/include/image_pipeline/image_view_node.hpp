@@ -15,14 +15,18 @@
 #ifndef IMAGE_PIPELINE__IMAGE_VIEW_NODE_HPP_
 #define IMAGE_PIPELINE__IMAGE_VIEW_NODE_HPP_
 
+#include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #include "opencv2/highgui/highgui.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "sensor_msgs/msg/image.hpp"
 
 #include "common.hpp"
+#include "frame_pool.hpp"
+#include "latency_tracer.hpp"
 
 /// Node which receives sensor_msgs/Image messages and renders them using OpenCV.
 class ImageViewNode final : public rclcpp::Node
@@ -32,50 +36,96 @@ public:
   /// \param input The topic name to subscribe to
   /// \param node_name The node name to use
   /// \param watermark Whether to add a watermark to the image before displaying
+  /// \param pool Optional pool to hand each message back to once it has been displayed
+  /// \param tracer Optional tracer to record the time spent on each frame into
+  /// \param display Whether to open a window, false consumes the images headless
   explicit ImageViewNode(
     const std::string & input, const std::string & node_name = "image_view_node",
-    bool watermark = true)
+    bool watermark = true, std::shared_ptr<FramePool> pool = nullptr,
+    std::shared_ptr<LatencyTracer> tracer = nullptr, bool display = true)
   : Node(node_name, rclcpp::NodeOptions().use_intra_process_comms(true))
   {
+    size_t stage = 0;
+    if (tracer) {
+      stage = tracer->add_stage(
+        node_name, this->get_node_topics_interface()->resolve_topic_name(input));
+    }
+    if (pool) {
+      // Take ownership of the message so it can be recycled instead of freed.
+      sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+        input,
+        rclcpp::SensorDataQoS(),
+        [node_name, watermark, pool, tracer, stage, display](
+          sensor_msgs::msg::Image::UniquePtr msg) {
+          traced_show_image(*msg, msg.get(), node_name, watermark, display, tracer.get(), stage);
+          pool->release(std::move(msg));
+        });
+      return;
+    }
     // Create a subscription on the input topic.
     sub_ = this->create_subscription<sensor_msgs::msg::Image>(
       input,
       rclcpp::SensorDataQoS(),
-      [node_name, watermark](sensor_msgs::msg::Image::ConstSharedPtr msg) {
-        // Create a cv::Mat from the image message (without copying).
-        cv::Mat cv_mat(
-          msg->height, msg->width,
-          encoding2mat_type(msg->encoding),
-          const_cast<unsigned char *>(msg->data.data()));
-        if (watermark) {
-          // Annotate with the pid and pointer address.
-          std::stringstream ss;
-          ss << "pid: " << GETPID() << ", ptr: " << msg.get();
-          draw_on_image(cv_mat, ss.str(), 60);
-        }
-        // Show the image.
-        cv::Mat c_mat = cv_mat;
-        cv::imshow(node_name.c_str(), c_mat);
-        char key = cv::waitKey(1);    // Look for key presses.
+      [node_name, watermark, tracer, stage, display](sensor_msgs::msg::Image::ConstSharedPtr msg) {
+        traced_show_image(*msg, msg.get(), node_name, watermark, display, tracer.get(), stage);
+      });
+  }
+
+private:
+  /// \brief Show an image, recording the time spent on it if a tracer is given
+  static void traced_show_image(
+    const sensor_msgs::msg::Image & msg, const void * ptr, const std::string & node_name,
+    bool watermark, bool display, LatencyTracer * tracer, size_t stage)
+  {
+    if (tracer) {
+      tracer->record(msg.header.stamp, stage, LatencyTracer::Event::Dequeue);
+    }
+    show_image(msg, ptr, node_name, watermark, display);
+    if (tracer) {
+      tracer->record(msg.header.stamp, stage, LatencyTracer::Event::Done);
+    }
+  }
+
+  /// \brief Render an image in a window named after the node and handle key presses
+  static void show_image(
+    const sensor_msgs::msg::Image & msg, const void * ptr, const std::string & node_name,
+    bool watermark, bool display)
+  {
+    // Create a cv::Mat from the image message (without copying).
+    cv::Mat cv_mat(
+      msg.height, msg.width,
+      encoding2mat_type(msg.encoding),
+      const_cast<unsigned char *>(msg.data.data()));
+    if (watermark) {
+      // Annotate with the pid and pointer address.
+      std::stringstream ss;
+      ss << "pid: " << GETPID() << ", ptr: " << ptr;
+      draw_on_image(cv_mat, ss.str(), 60);
+    }
+    if (!display) {
+      return;
+    }
+    // Show the image.
+    cv::Mat c_mat = cv_mat;
+    cv::imshow(node_name.c_str(), c_mat);
+    char key = cv::waitKey(1);    // Look for key presses.
+    if (key == 27 /* ESC */ || key == 'q') {
+      rclcpp::shutdown();
+    }
+    if (key == ' ') {    // If <space> then pause until another <space>.
+      key = '\0';
+      while (key != ' ') {
+        key = cv::waitKey(1);
         if (key == 27 /* ESC */ || key == 'q') {
           rclcpp::shutdown();
         }
-        if (key == ' ') {    // If <space> then pause until another <space>.
-          key = '\0';
-          while (key != ' ') {
-            key = cv::waitKey(1);
-            if (key == 27 /* ESC */ || key == 'q') {
-              rclcpp::shutdown();
-            }
-            if (!rclcpp::ok()) {
-              break;
-            }
-          }
+        if (!rclcpp::ok()) {
+          break;
         }
-      });
+      }
+    }
   }
 
-private:
   rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr sub_;
 
   cv::VideoCapture cap_;
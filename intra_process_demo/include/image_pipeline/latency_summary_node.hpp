@@ -0,0 +1,83 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__LATENCY_SUMMARY_NODE_HPP_
+#define IMAGE_PIPELINE__LATENCY_SUMMARY_NODE_HPP_
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "latency_tracer.hpp"
+
+/// Node which periodically prints latency percentiles of the frames traced by a LatencyTracer.
+/// For each stage, "wait" is the time a frame spent queued before the stage picked it up and
+/// "work" is the time the stage spent on it. For a source, "wait" is the time spent capturing.
+class LatencySummaryNode final : public rclcpp::Node
+{
+public:
+  /// \brief Construct a LatencySummaryNode reporting on the given tracer
+  /// \param tracer The tracer the pipeline stages record into
+  /// \param period How often to print a summary
+  /// \param node_name The node name to use
+  explicit LatencySummaryNode(
+    std::shared_ptr<LatencyTracer> tracer,
+    std::chrono::milliseconds period = std::chrono::milliseconds(5000),
+    const std::string & node_name = "latency_summary_node")
+  : Node(node_name), tracer_(std::move(tracer)), last_summary_(std::chrono::steady_clock::now())
+  {
+    timer_ = this->create_wall_timer(period, [this]() {return this->print_summary();});
+  }
+
+  /// \brief Print the percentiles of all frames completed since the last summary
+  void print_summary()
+  {
+    LatencyTracer::Samples samples = tracer_->collect();
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_summary_).count();
+    last_summary_ = now;
+    printf(
+      "%zu frames traced in %.1f s (%.1f fps), %zu incomplete.\n",
+      samples.end_to_end.size(), seconds, samples.end_to_end.size() / seconds,
+      samples.incomplete);
+    printf("Latency in microseconds (p50 / p90 / p99 / max):\n");
+    for (size_t stage = 0; stage < samples.stages.size(); ++stage) {
+      print_line((samples.stages[stage] + " wait").c_str(), samples.wait[stage]);
+      print_line((samples.stages[stage] + " work").c_str(), samples.work[stage]);
+    }
+    print_line("end to end", samples.end_to_end);
+  }
+
+private:
+  static void print_line(const char * label, std::vector<int64_t> & samples)
+  {
+    printf(
+      "  %-32s %10.1f %10.1f %10.1f %10.1f\n", label,
+      LatencyTracer::percentile(samples, 0.5) / 1000.0,
+      LatencyTracer::percentile(samples, 0.9) / 1000.0,
+      LatencyTracer::percentile(samples, 0.99) / 1000.0,
+      LatencyTracer::percentile(samples, 1.0) / 1000.0);
+  }
+
+  std::shared_ptr<LatencyTracer> tracer_;
+  std::chrono::steady_clock::time_point last_summary_;
+  rclcpp::TimerBase::SharedPtr timer_;
+};
+
+#endif  // IMAGE_PIPELINE__LATENCY_SUMMARY_NODE_HPP_
@@ -0,0 +1,223 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__LATENCY_TRACER_HPP_
+#define IMAGE_PIPELINE__LATENCY_TRACER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "builtin_interfaces/msg/time.hpp"
+
+/// Side-channel which collects per-stage timing records of the frames flowing through a pipeline.
+/// Frames are identified by their header stamp, so the messages themselves are left untouched.
+/// Each stage records when a frame was queued for it, when its callback picked the frame up and
+/// when it was done with it. Once every stage is done with a frame, its per-stage queue and
+/// processing times as well as its end-to-end latency become available through collect().
+class LatencyTracer final
+{
+public:
+  /// The timing records a stage makes for each frame.
+  enum class Event : size_t
+  {
+    /// The frame became available to the stage; for a source, when it started capturing.
+    Enqueue = 0,
+    /// The stage started working on the frame.
+    Dequeue = 1,
+    /// The stage finished working on the frame.
+    Done = 2,
+  };
+
+  static constexpr size_t max_stages = 16;
+
+  /// Samples collected since the last call to collect(), in nanoseconds.
+  struct Samples
+  {
+    std::vector<std::string> stages;
+    /// Per stage, the time frames waited between Enqueue and Dequeue.
+    std::vector<std::vector<int64_t>> wait;
+    /// Per stage, the time spent between Dequeue and Done.
+    std::vector<std::vector<int64_t>> work;
+    /// From the first Enqueue to the last Done of each frame.
+    std::vector<int64_t> end_to_end;
+    /// Frames which were overwritten before every stage was done with them.
+    size_t incomplete = 0;
+  };
+
+  /// \brief Construct a tracer
+  /// \param frames How many frames can be in flight at once, rounded up to a power of two
+  explicit LatencyTracer(size_t frames = 1024)
+  {
+    size_t size = 1;
+    while (size < frames) {
+      size <<= 1;
+    }
+    frames_.resize(size);
+  }
+
+  /// \brief Current time on the clock used for all records
+  static int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /// \brief Register a stage of the pipeline
+  /// \param name The name to report the stage under
+  /// \param input The fully qualified topic the stage subscribes to, empty for a source
+  /// \return The index to record events of this stage with
+  size_t add_stage(const std::string & name, const std::string & input = "")
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stages_.size() == max_stages) {
+      throw std::runtime_error("Too many stages to trace");
+    }
+    stages_.push_back({name, input});
+    pending_.stages.push_back(name);
+    pending_.wait.emplace_back();
+    pending_.work.emplace_back();
+    return stages_.size() - 1;
+  }
+
+  /// \brief Record an event of a stage for the frame with the given stamp
+  void record(
+    const builtin_interfaces::msg::Time & stamp, size_t stage, Event event,
+    int64_t time = now())
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Frame & frame = lookup(stamp);
+    if (frame.complete) {
+      return;
+    }
+    frame.times[stage][static_cast<size_t>(event)] = time;
+    if (event == Event::Done) {
+      frame.done |= 1u << stage;
+      if (frame.done == (1u << stages_.size()) - 1) {
+        harvest(frame);
+      }
+    }
+  }
+
+  /// \brief Record that a frame was published, which enqueues it for every stage reading the topic
+  /// \param topic The fully qualified topic the frame was published on
+  void published(
+    const builtin_interfaces::msg::Time & stamp, const std::string & topic, int64_t time = now())
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Frame & frame = lookup(stamp);
+    for (size_t stage = 0; stage < stages_.size(); ++stage) {
+      if (stages_[stage].second == topic) {
+        frame.times[stage][static_cast<size_t>(Event::Enqueue)] = time;
+      }
+    }
+  }
+
+  /// \brief Take the samples of all frames completed since the last call
+  Samples collect()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Samples samples;
+    samples.stages = pending_.stages;
+    samples.wait.resize(stages_.size());
+    samples.work.resize(stages_.size());
+    std::swap(samples.wait, pending_.wait);
+    std::swap(samples.work, pending_.work);
+    std::swap(samples.end_to_end, pending_.end_to_end);
+    std::swap(samples.incomplete, pending_.incomplete);
+    return samples;
+  }
+
+  /// \brief The value below which the given fraction of the samples fall
+  /// \param samples The samples, which get partially reordered
+  /// \param fraction A value in [0, 1]
+  static int64_t percentile(std::vector<int64_t> & samples, double fraction)
+  {
+    if (samples.empty()) {
+      return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  }
+
+private:
+  struct Frame
+  {
+    uint64_t key = 0;
+    /// One bit per stage which recorded Done.
+    uint32_t done = 0;
+    bool complete = false;
+    std::array<std::array<int64_t, 3>, max_stages> times{};
+  };
+
+  /// Find the slot of a frame, recycling whatever frame occupied it before.
+  Frame & lookup(const builtin_interfaces::msg::Time & stamp)
+  {
+    uint64_t key = static_cast<uint64_t>(stamp.sec) * 1000000000ull + stamp.nanosec;
+    // Mix the bits (splitmix64), since stamps of consecutive frames share most of them.
+    uint64_t hash = key + 0x9e3779b97f4a7c15ull;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    Frame & frame = frames_[hash & (frames_.size() - 1)];
+    if (frame.key != key) {
+      if (frame.key != 0 && !frame.complete) {
+        ++pending_.incomplete;
+      }
+      frame = Frame();
+      frame.key = key;
+    }
+    return frame;
+  }
+
+  void harvest(Frame & frame)
+  {
+    // Late records for the frame must not count it again.
+    frame.complete = true;
+    for (size_t stage = 0; stage < stages_.size(); ++stage) {
+      if (frame.times[stage][0] == 0 || frame.times[stage][1] == 0) {
+        // A stage joined the pipeline while the frame was in flight.
+        ++pending_.incomplete;
+        return;
+      }
+    }
+    int64_t first = std::numeric_limits<int64_t>::max();
+    int64_t last = std::numeric_limits<int64_t>::min();
+    for (size_t stage = 0; stage < stages_.size(); ++stage) {
+      const auto & times = frame.times[stage];
+      pending_.wait[stage].push_back(times[1] - times[0]);
+      pending_.work[stage].push_back(times[2] - times[1]);
+      first = std::min(first, times[0]);
+      last = std::max(last, times[2]);
+    }
+    pending_.end_to_end.push_back(last - first);
+  }
+
+  std::mutex mutex_;
+  /// Name and input topic of each stage.
+  std::vector<std::pair<std::string, std::string>> stages_;
+  std::vector<Frame> frames_;
+  Samples pending_;
+};
+
+#endif  // IMAGE_PIPELINE__LATENCY_TRACER_HPP_
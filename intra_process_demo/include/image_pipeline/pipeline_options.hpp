@@ -0,0 +1,106 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__PIPELINE_OPTIONS_HPP_
+#define IMAGE_PIPELINE__PIPELINE_OPTIONS_HPP_
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "rcutils/cmdline_parser.h"
+
+#include "camera_node.hpp"
+
+/// Command line options shared by the image pipeline demos.
+struct PipelineOptions
+{
+  /// Where the camera node takes its frames from.
+  CameraSource source;
+  /// Whether to consume the images without opening any window.
+  bool headless = false;
+  /// Whether to trace and periodically print the latency of each stage.
+  bool trace = false;
+  /// How many seconds to run before shutting down, 0 runs until interrupted.
+  double duration = 0.0;
+  /// Whether the usage was requested, in which case the demo should not run.
+  bool help = false;
+};
+
+void print_pipeline_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h              Print this help message.\n");
+  printf("  --pattern       Publish a synthetic test pattern instead of camera images.\n");
+  printf("  --file PATH     Publish the frames of a video file, played in a loop.\n");
+  printf("  --device N      Which camera device to use. Defaults to 0.\n");
+  printf("  --width PX      Width of the published images. Defaults to 320.\n");
+  printf("  --height PX     Height of the published images. Defaults to 240.\n");
+  printf(
+    "  --rate FPS      Frames per second to publish at most, 0 for as fast as possible.\n"
+    "                  Defaults to 30 for the pattern and to the pace of the camera or file.\n");
+  printf("  --headless      Consume the images without opening any window.\n");
+  printf("  --trace         Periodically print the latency of each stage of the pipeline.\n");
+  printf("  --duration S    Shut down after S seconds.\n");
+}
+
+std::string get_pipeline_option(char ** argv, char ** end, const char * option)
+{
+  const char * value = rcutils_cli_get_option(argv, end, option);
+  if (value == nullptr) {
+    throw std::invalid_argument(std::string(option) + " requires a value");
+  }
+  return value;
+}
+
+/// \brief Parse the command line of an image pipeline demo
+/// \throw std::invalid_argument if an option is missing its value or the value is malformed
+PipelineOptions parse_pipeline_options(int argc, char ** argv)
+{
+  PipelineOptions options;
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_pipeline_usage(argv[0]);
+    options.help = true;
+    return options;
+  }
+  if (rcutils_cli_option_exist(argv, end, "--pattern")) {
+    options.source.kind = CameraSource::Kind::Pattern;
+    options.source.rate = 30.0;
+  }
+  if (rcutils_cli_option_exist(argv, end, "--file")) {
+    options.source.kind = CameraSource::Kind::File;
+    options.source.file = get_pipeline_option(argv, end, "--file");
+  }
+  if (rcutils_cli_option_exist(argv, end, "--device")) {
+    options.source.device = std::stoi(get_pipeline_option(argv, end, "--device"));
+  }
+  if (rcutils_cli_option_exist(argv, end, "--width")) {
+    options.source.width = std::stoi(get_pipeline_option(argv, end, "--width"));
+  }
+  if (rcutils_cli_option_exist(argv, end, "--height")) {
+    options.source.height = std::stoi(get_pipeline_option(argv, end, "--height"));
+  }
+  if (rcutils_cli_option_exist(argv, end, "--rate")) {
+    options.source.rate = std::stod(get_pipeline_option(argv, end, "--rate"));
+  }
+  if (rcutils_cli_option_exist(argv, end, "--duration")) {
+    options.duration = std::stod(get_pipeline_option(argv, end, "--duration"));
+  }
+  options.headless = rcutils_cli_option_exist(argv, end, "--headless");
+  options.trace = rcutils_cli_option_exist(argv, end, "--trace");
+  return options;
+}
+
+#endif  // IMAGE_PIPELINE__PIPELINE_OPTIONS_HPP_
@@ -0,0 +1,118 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__TILED_FILTER_NODE_HPP_
+#define IMAGE_PIPELINE__TILED_FILTER_NODE_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "opencv2/opencv.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "sensor_msgs/msg/image.hpp"
+
+#include "common.hpp"
+#include "latency_tracer.hpp"
+#include "work_stealing_pool.hpp"
+
+/// Node that receives an image, runs a filter over it in place, and publishes it again.
+/// The frame is split into bands of rows which are filtered in parallel on a work-stealing
+/// pool, and the very same message is passed along, so the pipeline stays zero-copy.
+class TiledFilterNode final : public rclcpp::Node
+{
+public:
+  /// \brief Filter applied to one band of rows of the image, in place.
+  /// The first argument is the band, the second the index of its first row in the whole image.
+  /// Bands are processed concurrently, so the filter may only touch pixels of its own band.
+  using Filter = std::function<void(cv::Mat &, int)>;
+
+  /// \brief Construct a TiledFilterNode that filters images in place and republishes them
+  /// \param input The name of the topic to subscribe to
+  /// \param output The topic to publish filtered images to
+  /// \param filter The filter to run on each band of rows
+  /// \param node_name The node name to use
+  /// \param tile_rows How many rows each band spans
+  /// \param threads How many threads to filter on, defaults to one per core
+  /// \param tracer Optional tracer to record the time spent on each frame into
+  explicit TiledFilterNode(
+    const std::string & input, const std::string & output, Filter filter,
+    const std::string & node_name = "tiled_filter_node", int tile_rows = 16,
+    size_t threads = std::thread::hardware_concurrency(),
+    std::shared_ptr<LatencyTracer> tracer = nullptr)
+  : Node(node_name, rclcpp::NodeOptions().use_intra_process_comms(true)),
+    workers_(std::make_shared<WorkStealingPool>(threads))
+  {
+    if (tile_rows <= 0) {
+      throw std::invalid_argument("tile_rows must be positive");
+    }
+    rclcpp::SensorDataQoS qos;
+    // Create a publisher on the output topic.
+    pub_ = this->create_publisher<sensor_msgs::msg::Image>(output, qos);
+    std::weak_ptr<std::remove_pointer<decltype(pub_.get())>::type> captured_pub = pub_;
+    auto workers = workers_;
+    const std::string output_topic = pub_->get_topic_name();
+    size_t stage = 0;
+    if (tracer) {
+      stage = tracer->add_stage(
+        node_name, this->get_node_topics_interface()->resolve_topic_name(input));
+    }
+    // Create a subscription on the input topic.
+    sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+      input,
+      qos,
+      [captured_pub, workers, filter, tile_rows, tracer, stage, output_topic](
+        sensor_msgs::msg::Image::UniquePtr msg) {
+        auto pub_ptr = captured_pub.lock();
+        if (!pub_ptr) {
+          return;
+        }
+        if (tracer) {
+          tracer->record(msg->header.stamp, stage, LatencyTracer::Event::Dequeue);
+        }
+        // Create a cv::Mat from the image message (without copying).
+        cv::Mat cv_mat(
+          msg->height, msg->width,
+          encoding2mat_type(msg->encoding),
+          msg->data.data(), msg->step);
+        int rows = cv_mat.rows;
+        size_t tiles = static_cast<size_t>((rows + tile_rows - 1) / tile_rows);
+        workers->parallel_for(
+          tiles, [&cv_mat, &filter, rows, tile_rows](size_t tile) {
+            int first = static_cast<int>(tile) * tile_rows;
+            // The band shares its pixels with the message.
+            cv::Mat band = cv_mat.rowRange(first, std::min(first + tile_rows, rows));
+            filter(band, first);
+          });
+        if (tracer) {
+          int64_t now = LatencyTracer::now();
+          tracer->published(msg->header.stamp, output_topic, now);
+          tracer->record(msg->header.stamp, stage, LatencyTracer::Event::Done, now);
+        }
+        pub_ptr->publish(std::move(msg));  // Publish it along.
+      });
+  }
+
+private:
+  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr pub_;
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr sub_;
+
+  std::shared_ptr<WorkStealingPool> workers_;
+};
+
+#endif  // IMAGE_PIPELINE__TILED_FILTER_NODE_HPP_
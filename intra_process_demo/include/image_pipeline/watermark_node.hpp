@@ -25,6 +25,7 @@
 #include "sensor_msgs/msg/image.hpp"
 
 #include "common.hpp"
+#include "latency_tracer.hpp"
 
 /// Node that receives an image, adds some text as a watermark, and publishes it again.
 class WatermarkNode final : public rclcpp::Node
@@ -35,24 +36,35 @@ public:
   /// \param output The topic to publish watermarked images to
   /// \param text The text to add to the image
   /// \param node_name The node name to use
+  /// \param tracer Optional tracer to record the time spent on each frame into
   explicit WatermarkNode(
     const std::string & input, const std::string & output, const std::string & text,
-    const std::string & node_name = "watermark_node")
+    const std::string & node_name = "watermark_node",
+    std::shared_ptr<LatencyTracer> tracer = nullptr)
   : Node(node_name, rclcpp::NodeOptions().use_intra_process_comms(true))
   {
     rclcpp::SensorDataQoS qos;
     // Create a publisher on the input topic.
     pub_ = this->create_publisher<sensor_msgs::msg::Image>(output, qos);
     std::weak_ptr<std::remove_pointer<decltype(pub_.get())>::type> captured_pub = pub_;
+    const std::string output_topic = pub_->get_topic_name();
+    size_t stage = 0;
+    if (tracer) {
+      stage = tracer->add_stage(
+        node_name, this->get_node_topics_interface()->resolve_topic_name(input));
+    }
     // Create a subscription on the output topic.
     sub_ = this->create_subscription<sensor_msgs::msg::Image>(
       input,
       qos,
-      [captured_pub, text](sensor_msgs::msg::Image::UniquePtr msg) {
+      [captured_pub, text, tracer, stage, output_topic](sensor_msgs::msg::Image::UniquePtr msg) {
         auto pub_ptr = captured_pub.lock();
         if (!pub_ptr) {
           return;
         }
+        if (tracer) {
+          tracer->record(msg->header.stamp, stage, LatencyTracer::Event::Dequeue);
+        }
         // Create a cv::Mat from the image message (without copying).
         cv::Mat cv_mat(
           msg->height, msg->width,
@@ -62,6 +74,11 @@ public:
         std::stringstream ss;
         ss << "pid: " << GETPID() << ", ptr: " << msg.get() << " " << text;
         draw_on_image(cv_mat, ss.str(), 40);
+        if (tracer) {
+          int64_t now = LatencyTracer::now();
+          tracer->published(msg->header.stamp, output_topic, now);
+          tracer->record(msg->header.stamp, stage, LatencyTracer::Event::Done, now);
+        }
         pub_ptr->publish(std::move(msg));  // Publish it along.
       });
   }
@@ -0,0 +1,177 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMAGE_PIPELINE__WORK_STEALING_POOL_HPP_
+#define IMAGE_PIPELINE__WORK_STEALING_POOL_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads which run the iterations of a parallel loop.
+/// Each worker owns a queue of iterations which it drains from the front; a worker whose queue
+/// runs dry steals from the back of the others, so uneven iterations still balance out.
+/// The thread calling parallel_for() works along and returns once every iteration is done.
+class WorkStealingPool final
+{
+public:
+  /// \brief Start the workers
+  /// \param threads How many threads to run the loops on, including the calling thread
+  explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency())
+  : queues_(std::max<size_t>(threads, 1))
+  {
+    for (auto & queue : queues_) {
+      queue.reset(new Queue());
+    }
+    // Queue 0 belongs to the thread calling parallel_for().
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      workers_.emplace_back([this, i]() {return this->work(i);});
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+  ~WorkStealingPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      canceled_ = true;
+    }
+    wake_.notify_all();
+    for (auto & worker : workers_) {
+      worker.join();
+    }
+  }
+
+  size_t size() const
+  {
+    return queues_.size();
+  }
+
+  /// \brief Run body(i) for every i in [0, n) and wait for all of them to finish
+  /// Only one loop runs at a time; concurrent callers are serialized.
+  void parallel_for(size_t n, const std::function<void(size_t)> & body)
+  {
+    if (n == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> loop_lock(loop_mutex_);
+    {
+      // Publish the body before any iteration is visible, a worker still draining the previous
+      // loop may pick one up before it is woken.
+      std::lock_guard<std::mutex> lock(mutex_);
+      body_ = &body;
+      remaining_ = n;
+    }
+    // Deal the iterations out in contiguous blocks, so neighbouring tiles stay on one thread.
+    size_t per_queue = (n + queues_.size() - 1) / queues_.size();
+    for (size_t q = 0; q < queues_.size(); ++q) {
+      std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+      for (size_t i = q * per_queue; i < std::min(n, (q + 1) * per_queue); ++i) {
+        queues_[q]->items.push_back(i);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++generation_;
+    }
+    wake_.notify_all();
+    run(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() {return remaining_ == 0;});
+    body_ = nullptr;
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<size_t> items;
+  };
+
+  void work(size_t index)
+  {
+    size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, seen]() {return canceled_ || generation_ != seen;});
+        if (canceled_) {
+          return;
+        }
+        seen = generation_;
+      }
+      run(index);
+    }
+  }
+
+  /// Drain the own queue, then steal from the others until nothing is left.
+  void run(size_t index)
+  {
+    size_t item;
+    while (take(index, item) || steal(index, item)) {
+      (*body_)(item);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--remaining_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+
+  bool take(size_t index, size_t & item)
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    if (queues_[index]->items.empty()) {
+      return false;
+    }
+    item = queues_[index]->items.front();
+    queues_[index]->items.pop_front();
+    return true;
+  }
+
+  bool steal(size_t index, size_t & item)
+  {
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+      Queue & victim = *queues_[(index + offset) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.items.empty()) {
+        item = victim.items.back();
+        victim.items.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex loop_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(size_t)> * body_ = nullptr;
+  size_t remaining_ = 0;
+  size_t generation_ = 0;
+  bool canceled_ = false;
+};
+
+#endif  // IMAGE_PIPELINE__WORK_STEALING_POOL_HPP_
@@ -12,36 +12,80 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
 #include "std_msgs/msg/int32.hpp"
 
+#include "image_pipeline/latency_tracer.hpp"
+
 using namespace std::chrono_literals;
 
+// Bookkeeping of the benchmark mode, shared by all pipes of the ring.
+struct RingStats
+{
+  // When each message in flight last arrived at a pipe, keyed by its address.
+  std::unordered_map<std::uintptr_t, std::chrono::steady_clock::time_point> last_hop;
+  // Time between two consecutive arrivals of the same message, i.e. the latency of one hop.
+  std::vector<int64_t> hop_latencies;
+  size_t max_samples = 0;
+  uint64_t hops = 0;
+  // Messages which arrived at an address that was never published, i.e. copies.
+  uint64_t foreign_addresses = 0;
+
+  void record(const std_msgs::msg::Int32 * msg)
+  {
+    auto now = std::chrono::steady_clock::now();
+    auto entry = last_hop.find(reinterpret_cast<std::uintptr_t>(msg));
+    if (entry == last_hop.end()) {
+      ++foreign_addresses;
+      return;
+    }
+    if (hop_latencies.size() < max_samples) {
+      hop_latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry->second).count());
+    }
+    entry->second = now;
+    ++hops;
+  }
+};
+
 // This node receives an Int32, waits 1 second, then increments and sends it.
+// In benchmark mode it records the hop and sends the message along right away.
 struct IncrementerPipe : public rclcpp::Node
 {
-  IncrementerPipe(const std::string & name, const std::string & in, const std::string & out)
+  IncrementerPipe(
+    const std::string & name, const std::string & in, const std::string & out,
+    std::shared_ptr<RingStats> stats = nullptr, size_t depth = 10)
   : Node(name, rclcpp::NodeOptions().use_intra_process_comms(true))
   {
     // Create a publisher on the output topic.
-    pub = this->create_publisher<std_msgs::msg::Int32>(out, 10);
+    pub = this->create_publisher<std_msgs::msg::Int32>(out, depth);
     std::weak_ptr<std::remove_pointer<decltype(pub.get())>::type> captured_pub = pub;
     // Create a subscription on the input topic.
     sub = this->create_subscription<std_msgs::msg::Int32>(
       in,
-      10,
-      [captured_pub](std_msgs::msg::Int32::UniquePtr msg) {
+      depth,
+      [captured_pub, stats](std_msgs::msg::Int32::UniquePtr msg) {
         auto pub_ptr = captured_pub.lock();
         if (!pub_ptr) {
           return;
         }
+        if (stats) {
+          stats->record(msg.get());
+          msg->data++;
+          pub_ptr->publish(std::move(msg));
+          return;
+        }
         printf(
           "Received message with value:         %d, and address: 0x%" PRIXPTR "\n", msg->data,
           reinterpret_cast<std::uintptr_t>(msg.get()));
@@ -62,9 +106,105 @@ struct IncrementerPipe : public rclcpp::Node
   rclcpp::Subscription<std_msgs::msg::Int32>::SharedPtr sub;
 };
 
+// Send messages around a ring of pipes as fast as the executor dispatches them.
+int run_benchmark(size_t pipes, size_t in_flight, uint64_t hops)
+{
+  rclcpp::executors::SingleThreadedExecutor executor;
+  auto stats = std::make_shared<RingStats>();
+  stats->max_samples = static_cast<size_t>(std::min<uint64_t>(hops, 10000000));
+  stats->hop_latencies.reserve(stats->max_samples);
+  stats->last_hop.reserve(in_flight);
+
+  // Pipe i reads topic i and writes topic i + 1, the last one closes the ring.
+  // Every queue must be able to hold all messages at once, or some would be dropped.
+  std::vector<std::shared_ptr<IncrementerPipe>> ring;
+  for (size_t i = 0; i < pipes; ++i) {
+    ring.push_back(
+      std::make_shared<IncrementerPipe>(
+        "pipe" + std::to_string(i + 1), "topic" + std::to_string(i + 1),
+        "topic" + std::to_string((i + 1) % pipes + 1), stats, in_flight));
+    executor.add_node(ring.back());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < in_flight; ++i) {
+    std::unique_ptr<std_msgs::msg::Int32> msg(new std_msgs::msg::Int32());
+    stats->last_hop[reinterpret_cast<std::uintptr_t>(msg.get())] = start;
+    ring.back()->pub->publish(std::move(msg));
+  }
+  while (rclcpp::ok() && stats->hops + stats->foreign_addresses < hops) {
+    executor.spin_some();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf(
+    "%zu pipes, %zu messages in flight: %" PRIu64 " hops in %.3f s, %.0f hops/s\n",
+    pipes, in_flight, stats->hops, seconds, static_cast<double>(stats->hops) / seconds);
+  printf(
+    "hop latency in microseconds: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+    LatencyTracer::percentile(stats->hop_latencies, 0.5) / 1000.0,
+    LatencyTracer::percentile(stats->hop_latencies, 0.9) / 1000.0,
+    LatencyTracer::percentile(stats->hop_latencies, 0.99) / 1000.0,
+    LatencyTracer::percentile(stats->hop_latencies, 1.0) / 1000.0);
+  if (stats->foreign_addresses == 0) {
+    printf("All %zu messages kept their address, no copies were made.\n", in_flight);
+  } else {
+    printf(
+      "%" PRIu64 " messages arrived at an address which was never published, "
+      "copies were made.\n", stats->foreign_addresses);
+  }
+  return stats->foreign_addresses == 0 ? 0 : 1;
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h              Print this help message.\n");
+  printf("  --benchmark     Pass messages around without sleeping or printing and report.\n");
+  printf("  --pipes N       Number of pipes in the ring (benchmark only). Defaults to 2.\n");
+  printf("  --in-flight K   Messages sent around at once (benchmark only). Defaults to 1.\n");
+  printf("  --hops H        Hops to run for (benchmark only). Defaults to 1000000.\n");
+}
+
 int main(int argc, char * argv[])
 {
   setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  if (rcutils_cli_option_exist(argv, end, "--benchmark")) {
+    size_t pipes = 2;
+    size_t in_flight = 1;
+    uint64_t hops = 1000000;
+    try {
+      if (rcutils_cli_option_exist(argv, end, "--pipes")) {
+        const char * value = rcutils_cli_get_option(argv, end, "--pipes");
+        pipes = std::stoul(value ? value : "");
+      }
+      if (rcutils_cli_option_exist(argv, end, "--in-flight")) {
+        const char * value = rcutils_cli_get_option(argv, end, "--in-flight");
+        in_flight = std::stoul(value ? value : "");
+      }
+      if (rcutils_cli_option_exist(argv, end, "--hops")) {
+        const char * value = rcutils_cli_get_option(argv, end, "--hops");
+        hops = std::stoull(value ? value : "");
+      }
+    } catch (const std::exception &) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    if (pipes == 0 || in_flight == 0) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    rclcpp::init(argc, argv);
+    int ret = run_benchmark(pipes, in_flight, hops);
+    rclcpp::shutdown();
+    return ret;
+  }
+
   rclcpp::init(argc, argv);
   rclcpp::executors::SingleThreadedExecutor executor;
 
@@ -0,0 +1,220 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "sensor_msgs/msg/image.hpp"
+
+#include "image_pipeline/latency_tracer.hpp"
+
+// Measures what intra-process delivery of one image to many subscriptions costs.
+// For each combination of subscriber count, callback signature and frame size, frames are
+// published as unique_ptr and every subscription checks whether it got the published buffer
+// or a copy of it. The report lists copies per frame, the bandwidth spent on those copies and
+// the latency from publish() to the start of each callback.
+
+enum class CallbackKind
+{
+  UniquePtr,
+  ConstSharedPtr,
+  // Half of the subscriptions take a unique_ptr, the other half a const shared_ptr.
+  Mixed,
+};
+
+const char * to_string(CallbackKind kind)
+{
+  switch (kind) {
+    case CallbackKind::UniquePtr:
+      return "unique_ptr";
+    case CallbackKind::ConstSharedPtr:
+      return "shared_ptr";
+    case CallbackKind::Mixed:
+      return "mixed";
+  }
+  return "";
+}
+
+// What the subscriptions observed about the frame currently being delivered.
+// A copy is counted once per buffer, however many subscriptions it reaches: rclcpp makes one
+// copy for all of the const shared_ptr subscriptions together. The copies are all made in
+// publish(), before any callback runs, so no two of them share an address.
+struct Delivery
+{
+  const uint8_t * published_data = nullptr;
+  int64_t publish_time = 0;
+  size_t received = 0;
+  std::vector<const uint8_t *> copies;
+  std::vector<int64_t> latencies;
+
+  void start(const uint8_t * data)
+  {
+    published_data = data;
+    received = 0;
+    copies.clear();
+    publish_time = LatencyTracer::now();
+  }
+
+  void receive(const sensor_msgs::msg::Image & msg)
+  {
+    latencies.push_back(LatencyTracer::now() - publish_time);
+    const uint8_t * data = msg.data.data();
+    if (data != published_data && std::find(copies.begin(), copies.end(), data) == copies.end()) {
+      copies.push_back(data);
+    }
+    ++received;
+  }
+};
+
+// Node with one publisher and a configurable number of subscriptions on the same topic.
+struct FanOut : public rclcpp::Node
+{
+  FanOut(size_t subscribers, CallbackKind kind, Delivery & delivery)
+  : Node("fan_out", rclcpp::NodeOptions().use_intra_process_comms(true))
+  {
+    rclcpp::QoS qos(1);
+    pub = this->create_publisher<sensor_msgs::msg::Image>("frames", qos);
+    for (size_t i = 0; i < subscribers; ++i) {
+      bool unique = kind == CallbackKind::UniquePtr ||
+        (kind == CallbackKind::Mixed && i % 2 == 0);
+      if (unique) {
+        subs.push_back(
+          this->create_subscription<sensor_msgs::msg::Image>(
+            "frames", qos, [&delivery](sensor_msgs::msg::Image::UniquePtr msg) {
+              delivery.receive(*msg);
+            }));
+      } else {
+        subs.push_back(
+          this->create_subscription<sensor_msgs::msg::Image>(
+            "frames", qos, [&delivery](sensor_msgs::msg::Image::ConstSharedPtr msg) {
+              delivery.receive(*msg);
+            }));
+      }
+    }
+  }
+
+  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr pub;
+  std::vector<rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr> subs;
+};
+
+// Deliver the given number of frames to the subscriptions and print one line of the report.
+void run(size_t subscribers, CallbackKind kind, int width, int height, size_t frames)
+{
+  Delivery delivery;
+  delivery.copies.reserve(subscribers);
+  delivery.latencies.reserve(frames * subscribers);
+  auto node = std::make_shared<FanOut>(subscribers, kind, delivery);
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+
+  size_t frame_bytes = static_cast<size_t>(width) * static_cast<size_t>(height) * 3;
+  int64_t busy = 0;
+  size_t copies = 0;
+  for (size_t frame = 0; frame < frames && rclcpp::ok(); ++frame) {
+    auto msg = std::make_unique<sensor_msgs::msg::Image>();
+    msg->width = width;
+    msg->height = height;
+    msg->encoding = "bgr8";
+    msg->step = width * 3;
+    msg->data.resize(frame_bytes);
+    delivery.start(msg->data.data());
+    node->pub->publish(std::move(msg));
+    while (delivery.received < subscribers && rclcpp::ok()) {
+      executor.spin_some();
+    }
+    busy += LatencyTracer::now() - delivery.publish_time;
+    copies += delivery.copies.size();
+  }
+
+  double seconds = busy / 1e9;
+  printf(
+    "%11zu  %-10s  %4dx%-4d  %12.2f  %12.1f  %10.1f  %10.1f  %10.1f\n",
+    subscribers, to_string(kind), width, height,
+    static_cast<double>(copies) / static_cast<double>(frames),
+    static_cast<double>(copies * frame_bytes) / seconds / 1e6,
+    LatencyTracer::percentile(delivery.latencies, 0.5) / 1000.0,
+    LatencyTracer::percentile(delivery.latencies, 0.99) / 1000.0,
+    LatencyTracer::percentile(delivery.latencies, 1.0) / 1000.0);
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h                    Print this help message.\n");
+  printf("  --frames N            Frames to publish per configuration. Defaults to 100.\n");
+  printf(
+    "  --max-subscribers N   Largest subscriber count, counts double from 1. "
+    "Defaults to 64.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  size_t frames = 100;
+  size_t max_subscribers = 64;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--frames")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--frames");
+      frames = std::stoul(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--max-subscribers")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--max-subscribers");
+      max_subscribers = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (frames == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+
+  const std::pair<int, int> sizes[] = {{320, 240}, {1280, 720}, {1920, 1080}};
+  const CallbackKind kinds[] =
+  {CallbackKind::UniquePtr, CallbackKind::ConstSharedPtr, CallbackKind::Mixed};
+
+  printf(
+    "subscribers  callback    frame      copies/frame  copy MB/s     "
+    "p50 us      p99 us      max us\n");
+  for (const auto & size : sizes) {
+    for (const auto kind : kinds) {
+      for (size_t subscribers = 1; subscribers <= max_subscribers && rclcpp::ok();
+        subscribers *= 2)
+      {
+        run(subscribers, kind, size.first, size.second, frames);
+      }
+    }
+  }
+
+  rclcpp::shutdown();
+
+  return 0;
+}
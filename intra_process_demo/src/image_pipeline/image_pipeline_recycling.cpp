@@ -0,0 +1,58 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "image_pipeline/camera_node.hpp"
+#include "image_pipeline/frame_pool.hpp"
+#include "image_pipeline/image_view_node.hpp"
+#include "image_pipeline/watermark_node.hpp"
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  rclcpp::executors::SingleThreadedExecutor executor;
+
+  // Frames circulate camera_node -> watermark_node -> image_view_node -> back to camera_node.
+  // A handful of 320x240 bgr8 frames is enough to cover the ones in flight.
+  auto pool = std::make_shared<FramePool>(8, 320 * 240 * 3);
+
+  std::shared_ptr<CameraNode> camera_node = nullptr;
+  try {
+    camera_node = std::make_shared<CameraNode>("image", "camera_node", true, CameraSource(), pool);
+  } catch (const std::exception & e) {
+    fprintf(stderr, "%s Exiting ..\n", e.what());
+    return 1;
+  }
+  auto watermark_node =
+    std::make_shared<WatermarkNode>("image", "watermarked_image", "Hello world!");
+  auto image_view_node =
+    std::make_shared<ImageViewNode>("watermarked_image", "image_view_node", true, pool);
+
+  executor.add_node(camera_node);
+  executor.add_node(watermark_node);
+  executor.add_node(image_view_node);
+
+  executor.spin();
+
+  // Stop capturing before reading the counters.
+  camera_node.reset();
+  pool->print_stats();
+
+  rclcpp::shutdown();
+
+  return 0;
+}
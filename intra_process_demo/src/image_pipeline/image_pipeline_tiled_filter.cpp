@@ -0,0 +1,60 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "image_pipeline/camera_node.hpp"
+#include "image_pipeline/image_view_node.hpp"
+#include "image_pipeline/tiled_filter_node.hpp"
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  rclcpp::executors::SingleThreadedExecutor executor;
+
+  // Connect the nodes as a pipeline: camera_node -> tiled_filter_node -> image_view_node
+  std::shared_ptr<CameraNode> camera_node = nullptr;
+  try {
+    camera_node = std::make_shared<CameraNode>("image");
+  } catch (const std::exception & e) {
+    fprintf(stderr, "%s Exiting ..\n", e.what());
+    return 1;
+  }
+
+  std::stringstream ss;
+  ss << "pid: " << GETPID() << " Hello world!";
+  const std::string text = ss.str();
+  // Each band draws the part of the watermark which falls into its rows, shifted by its offset.
+  // The drawing is clipped to the band, so together the bands render the whole text.
+  auto watermark = [text](cv::Mat & band, int first_row) {
+      draw_on_image(band, text, 40 - first_row);
+    };
+  auto tiled_filter_node = std::make_shared<TiledFilterNode>(
+    "image", "watermarked_image", watermark);
+  auto image_view_node = std::make_shared<ImageViewNode>("watermarked_image");
+
+  executor.add_node(camera_node);
+  executor.add_node(tiled_filter_node);
+  executor.add_node(image_view_node);
+
+  executor.spin();
+
+  rclcpp::shutdown();
+
+  return 0;
+}
@@ -12,39 +12,82 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
 #include <memory>
 
 #include "rclcpp/rclcpp.hpp"
 
 #include "image_pipeline/camera_node.hpp"
 #include "image_pipeline/image_view_node.hpp"
+#include "image_pipeline/latency_summary_node.hpp"
+#include "image_pipeline/latency_tracer.hpp"
+#include "image_pipeline/pipeline_options.hpp"
 #include "image_pipeline/watermark_node.hpp"
 
 int main(int argc, char * argv[])
 {
+  // With --pattern and --headless the pipeline needs neither a camera nor a display, and with
+  // --rate 0 it turns into a throughput benchmark of the intra-process path, see -h.
+  PipelineOptions options;
+  try {
+    options = parse_pipeline_options(argc, argv);
+  } catch (const std::exception & e) {
+    fprintf(stderr, "%s\n", e.what());
+    print_pipeline_usage(argv[0]);
+    return 1;
+  }
+  if (options.help) {
+    return 0;
+  }
+
   rclcpp::init(argc, argv);
   rclcpp::executors::SingleThreadedExecutor executor;
 
+  std::shared_ptr<LatencyTracer> tracer = nullptr;
+  if (options.trace) {
+    tracer = std::make_shared<LatencyTracer>();
+  }
+
   // Connect the nodes as a pipeline: camera_node -> watermark_node -> image_view_node
   // And the extra image view as a fork:                           \-> image_view_node2
   std::shared_ptr<CameraNode> camera_node = nullptr;
   try {
-    camera_node = std::make_shared<CameraNode>("image");
+    camera_node = std::make_shared<CameraNode>(
+      "image", "camera_node", true, options.source, nullptr, tracer);
   } catch (const std::exception & e) {
     fprintf(stderr, "%s Exiting..\n", e.what());
     return 1;
   }
-  auto watermark_node =
-    std::make_shared<WatermarkNode>("image", "watermarked_image", "Hello world!");
-  auto image_view_node = std::make_shared<ImageViewNode>("watermarked_image");
-  auto image_view_node2 = std::make_shared<ImageViewNode>("watermarked_image", "image_view_node2");
+  auto watermark_node = std::make_shared<WatermarkNode>(
+    "image", "watermarked_image", "Hello world!", "watermark_node", tracer);
+  auto image_view_node = std::make_shared<ImageViewNode>(
+    "watermarked_image", "image_view_node", true, nullptr, tracer, !options.headless);
+  auto image_view_node2 = std::make_shared<ImageViewNode>(
+    "watermarked_image", "image_view_node2", true, nullptr, tracer, !options.headless);
 
   executor.add_node(camera_node);
   executor.add_node(watermark_node);
   executor.add_node(image_view_node);
   executor.add_node(image_view_node2);
+  std::shared_ptr<LatencySummaryNode> latency_summary_node = nullptr;
+  if (tracer) {
+    latency_summary_node = std::make_shared<LatencySummaryNode>(tracer);
+    executor.add_node(latency_summary_node);
+  }
 
-  executor.spin();
+  if (options.duration > 0.0) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<
+      std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.duration));
+    while (rclcpp::ok() && std::chrono::steady_clock::now() < end) {
+      executor.spin_once(std::chrono::milliseconds(100));
+    }
+  } else {
+    executor.spin();
+  }
+
+  if (latency_summary_node) {
+    latency_summary_node->print_summary();
+  }
 
   rclcpp::shutdown();
 
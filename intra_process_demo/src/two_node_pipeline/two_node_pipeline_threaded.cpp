@@ -0,0 +1,399 @@
+// Copyright 2015 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcutils/cmdline_parser.h"
+#include "std_msgs/msg/int32.hpp"
+
+#include "image_pipeline/latency_tracer.hpp"
+
+using namespace std::chrono_literals;
+
+// The two_node_pipeline, with the producer and the consumer each running on its own thread
+// pinned to its own core. With --benchmark, the producer publishes as fast as it can and the
+// sustained rate and latency are compared between a single-threaded executor, two pinned
+// executors and a bare lock-free single-producer/single-consumer ring without rclcpp.
+
+// Pin a thread to a core, so producer and consumer do not migrate or share a core.
+void pin_thread(std::thread & thread, unsigned int core)
+{
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cpuset);
+  if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+    fprintf(stderr, "Could not pin thread to core %u\n", core);
+  }
+#else
+  (void)thread;
+  (void)core;
+#endif
+}
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+template<typename T, size_t Capacity>
+class SpscRing
+{
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  bool push(T && item)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == Capacity) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == Capacity) {
+        return false;
+      }
+    }
+    items_[tail & (Capacity - 1)] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T & item)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return false;
+      }
+    }
+    item = std::move(items_[head & (Capacity - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, Capacity> items_;
+  // Each index is written by one side only; the caches save reading the other side's line.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) size_t tail_cache_ = 0;
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) size_t head_cache_ = 0;
+};
+
+// Send times of the messages in flight, indexed by their value, and what the consumer saw.
+struct Measurement
+{
+  static constexpr size_t slots = 1 << 16;
+  std::array<std::atomic<int64_t>, slots> sent{};
+  std::vector<int64_t> latencies;
+  uint64_t received = 0;
+  uint64_t dropped = 0;
+  int32_t expected = 0;
+
+  Measurement()
+  {
+    // Keep at most this many latency samples, so recording never allocates.
+    latencies.reserve(1000000);
+  }
+
+  void send(int32_t value)
+  {
+    sent[static_cast<size_t>(value) & (slots - 1)].store(
+      LatencyTracer::now(), std::memory_order_relaxed);
+  }
+
+  void receive(int32_t value)
+  {
+    int64_t latency = LatencyTracer::now() -
+      sent[static_cast<size_t>(value) & (slots - 1)].load(std::memory_order_relaxed);
+    if (latencies.size() < latencies.capacity()) {
+      latencies.push_back(latency);
+    }
+    if (value > expected) {
+      dropped += static_cast<uint64_t>(value - expected);
+    }
+    expected = value + 1;
+    ++received;
+  }
+};
+
+// Node that produces messages, on a timer or, in benchmark mode, from its own loop.
+struct Producer : public rclcpp::Node
+{
+  Producer(const std::string & name, const std::string & output, size_t depth = 10)
+  : Node(name, rclcpp::NodeOptions().use_intra_process_comms(true))
+  {
+    // Create a publisher on the output topic.
+    pub_ = this->create_publisher<std_msgs::msg::Int32>(output, depth);
+  }
+
+  // Publish at ~1Hz, as in two_node_pipeline.
+  void start_timer()
+  {
+    std::weak_ptr<std::remove_pointer<decltype(pub_.get())>::type> captured_pub = pub_;
+    auto callback = [captured_pub, count = 0]() mutable -> void {
+        auto pub_ptr = captured_pub.lock();
+        if (!pub_ptr) {
+          return;
+        }
+        std_msgs::msg::Int32::UniquePtr msg(new std_msgs::msg::Int32());
+        msg->data = count++;
+        printf(
+          "Published message with value: %d, and address: 0x%" PRIXPTR "\n", msg->data,
+          reinterpret_cast<std::uintptr_t>(msg.get()));
+        pub_ptr->publish(std::move(msg));
+      };
+    timer_ = this->create_wall_timer(1s, callback);
+  }
+
+  // Publish one message with the next value, recording when it was sent.
+  void publish_next(Measurement & measurement)
+  {
+    std_msgs::msg::Int32::UniquePtr msg(new std_msgs::msg::Int32());
+    msg->data = count_++;
+    measurement.send(msg->data);
+    pub_->publish(std::move(msg));
+  }
+
+  rclcpp::Publisher<std_msgs::msg::Int32>::SharedPtr pub_;
+  rclcpp::TimerBase::SharedPtr timer_;
+  int32_t count_ = 0;
+};
+
+// Node that consumes messages, printing them or handing them to a measurement.
+struct Consumer : public rclcpp::Node
+{
+  Consumer(
+    const std::string & name, const std::string & input, Measurement * measurement = nullptr,
+    size_t depth = 10)
+  : Node(name, rclcpp::NodeOptions().use_intra_process_comms(true))
+  {
+    // Create a subscription on the input topic which prints on receipt of new messages.
+    sub_ = this->create_subscription<std_msgs::msg::Int32>(
+      input,
+      depth,
+      [measurement](std_msgs::msg::Int32::UniquePtr msg) {
+        if (measurement) {
+          measurement->receive(msg->data);
+          return;
+        }
+        printf(
+          " Received message with value: %d, and address: 0x%" PRIXPTR "\n", msg->data,
+          reinterpret_cast<std::uintptr_t>(msg.get()));
+      });
+  }
+
+  rclcpp::Subscription<std_msgs::msg::Int32>::SharedPtr sub_;
+};
+
+struct Result
+{
+  std::string name;
+  double seconds = 0.0;
+  Measurement * measurement = nullptr;
+};
+
+// Producer and consumer share one single-threaded executor, as in two_node_pipeline.
+void run_single_threaded(Measurement & measurement, std::chrono::duration<double> duration)
+{
+  rclcpp::executors::SingleThreadedExecutor executor;
+  auto producer = std::make_shared<Producer>("producer", "number");
+  auto consumer = std::make_shared<Consumer>("consumer", "number", &measurement);
+  executor.add_node(producer);
+  executor.add_node(consumer);
+  auto end = std::chrono::steady_clock::now() + duration;
+  while (rclcpp::ok() && std::chrono::steady_clock::now() < end) {
+    producer->publish_next(measurement);
+    executor.spin_some();
+  }
+}
+
+// Producer publishes from its own pinned thread, the consumer spins its own pinned executor.
+void run_pinned_executors(
+  Measurement & measurement, std::chrono::duration<double> duration, size_t depth)
+{
+  auto producer = std::make_shared<Producer>("producer", "number", depth);
+  auto consumer = std::make_shared<Consumer>("consumer", "number", &measurement, depth);
+  rclcpp::executors::SingleThreadedExecutor consumer_executor;
+  consumer_executor.add_node(consumer);
+  std::atomic<bool> done(false);
+
+  std::thread consumer_thread([&consumer_executor, &done]() {
+      while (rclcpp::ok() && !done.load()) {
+        consumer_executor.spin_once(10ms);
+      }
+    });
+  pin_thread(consumer_thread, 1);
+  std::thread producer_thread([&producer, &measurement, &done]() {
+      while (rclcpp::ok() && !done.load()) {
+        producer->publish_next(measurement);
+      }
+    });
+  pin_thread(producer_thread, 0);
+
+  std::this_thread::sleep_for(duration);
+  done.store(true);
+  producer_thread.join();
+  consumer_thread.join();
+}
+
+// The same hand-over through a bare lock-free ring, as a lower bound for the cost.
+void run_spsc_ring(Measurement & measurement, std::chrono::duration<double> duration)
+{
+  auto ring = std::make_unique<SpscRing<std_msgs::msg::Int32::UniquePtr, 1024>>();
+  std::atomic<bool> done(false);
+
+  std::thread consumer_thread([&ring, &measurement, &done]() {
+      std_msgs::msg::Int32::UniquePtr msg;
+      while (!done.load(std::memory_order_relaxed)) {
+        if (ring->pop(msg)) {
+          measurement.receive(msg->data);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  pin_thread(consumer_thread, 1);
+  std::thread producer_thread([&ring, &measurement, &done]() {
+      int32_t count = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        std_msgs::msg::Int32::UniquePtr msg(new std_msgs::msg::Int32());
+        msg->data = count;
+        measurement.send(count);
+        // Wait for room rather than dropping, the ring applies backpressure.
+        while (!ring->push(std::move(msg)) && !done.load(std::memory_order_relaxed)) {
+          std::this_thread::yield();
+        }
+        ++count;
+      }
+    });
+  pin_thread(producer_thread, 0);
+
+  std::this_thread::sleep_for(duration);
+  done.store(true);
+  producer_thread.join();
+  consumer_thread.join();
+}
+
+void print_usage(const char * executable)
+{
+  printf("Usage: %s [options]\n", executable);
+  printf("  -h              Print this help message.\n");
+  printf("  --benchmark     Measure the sustained rate and latency at saturation.\n");
+  printf("  --duration S    Seconds to measure each variant for. Defaults to 2.\n");
+  printf("  --depth N       Queue depth of the pinned executor variant. Defaults to 100.\n");
+}
+
+int main(int argc, char * argv[])
+{
+  setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+  char ** end = argv + argc;
+  if (rcutils_cli_option_exist(argv, end, "-h")) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  double duration = 2.0;
+  size_t depth = 100;
+  try {
+    if (rcutils_cli_option_exist(argv, end, "--duration")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--duration");
+      duration = std::stod(value ? value : "");
+    }
+    if (rcutils_cli_option_exist(argv, end, "--depth")) {
+      const char * value = rcutils_cli_get_option(argv, end, "--depth");
+      depth = std::stoul(value ? value : "");
+    }
+  } catch (const std::exception &) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  bool benchmark = rcutils_cli_option_exist(argv, end, "--benchmark");
+
+  rclcpp::init(argc, argv);
+
+  if (!benchmark) {
+    // Each node gets an executor of its own, spun on a thread pinned to its own core.
+    rclcpp::executors::SingleThreadedExecutor producer_executor;
+    rclcpp::executors::SingleThreadedExecutor consumer_executor;
+    auto producer = std::make_shared<Producer>("producer", "number");
+    producer->start_timer();
+    auto consumer = std::make_shared<Consumer>("consumer", "number");
+    producer_executor.add_node(producer);
+    consumer_executor.add_node(consumer);
+    std::thread producer_thread([&producer_executor]() {producer_executor.spin();});
+    pin_thread(producer_thread, 0);
+    std::thread consumer_thread([&consumer_executor]() {consumer_executor.spin();});
+    pin_thread(consumer_thread, 1);
+    producer_thread.join();
+    consumer_thread.join();
+    rclcpp::shutdown();
+    return 0;
+  }
+
+  std::chrono::duration<double> measure_for(duration);
+  std::vector<Result> results;
+  std::vector<std::unique_ptr<Measurement>> measurements;
+  for (int variant = 0; variant < 3 && rclcpp::ok(); ++variant) {
+    measurements.push_back(std::make_unique<Measurement>());
+    Measurement & measurement = *measurements.back();
+    Result result;
+    result.measurement = &measurement;
+    auto start = std::chrono::steady_clock::now();
+    switch (variant) {
+      case 0:
+        result.name = "single-threaded executor";
+        run_single_threaded(measurement, measure_for);
+        break;
+      case 1:
+        result.name = "pinned executor threads";
+        run_pinned_executors(measurement, measure_for, depth);
+        break;
+      case 2:
+        result.name = "pinned threads, SPSC ring";
+        run_spsc_ring(measurement, measure_for);
+        break;
+    }
+    result.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    results.push_back(result);
+  }
+
+  rclcpp::shutdown();
+
+  printf(
+    "%-28s %14s %12s %10s %10s %10s\n", "variant", "messages/s", "dropped", "p50 us",
+    "p99 us", "max us");
+  for (auto & result : results) {
+    Measurement & m = *result.measurement;
+    printf(
+      "%-28s %14.0f %12" PRIu64 " %10.2f %10.2f %10.2f\n", result.name.c_str(),
+      static_cast<double>(m.received) / result.seconds, m.dropped,
+      LatencyTracer::percentile(m.latencies, 0.5) / 1000.0,
+      LatencyTracer::percentile(m.latencies, 0.99) / 1000.0,
+      LatencyTracer::percentile(m.latencies, 1.0) / 1000.0);
+  }
+
+  return 0;
+}